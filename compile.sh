@@ -1,5 +1,9 @@
 #!/bin/bash
 
-g++ main.cpp hardware_drivers/gpio.cpp hardware_drivers/spi.cpp ic_controllers/MCP23S17.cpp ic_controllers/AD8802.cpp ic_controllers/LTC2380.cpp -o test -lwiringPi
+g++ main.cpp hardware_drivers/gpio.cpp hardware_drivers/spi.cpp ic_controllers/MCP23S17.cpp ic_controllers/AD8802.cpp ic_controllers/LTC2380.cpp ic_controllers/fixture_bus.cpp test_framework/bus_worker.cpp test_framework/fixture.cpp test_framework/fixture_scheduler.cpp test_framework/test_plan.cpp test_framework/step_scheduler.cpp test_framework/bus_cost_model.cpp test_framework/test_plan_runner.cpp test_framework/test_server.cpp test_framework/result_log.cpp diagnostics/tracer.cpp diagnostics/jitter_benchmark.cpp test_framework/realtime.cpp test_framework/calibrator.cpp ic_controllers/calibration_table.cpp -o test -lwiringPi -pthread
 
-echo Program Compiled!
\ No newline at end of file
+g++ tools/plan_compiler.cpp test_framework/test_plan.cpp test_framework/step_scheduler.cpp test_framework/bus_cost_model.cpp ic_controllers/calibration_table.cpp -o plan_compiler
+
+g++ tools/log_exporter.cpp test_framework/result_log.cpp -o log_exporter
+
+echo Program Compiled!
@@ -0,0 +1,180 @@
+/*
+ * jitter_benchmark.cpp:
+ ***********************************************************************
+ * Measures scheduling jitter on the RPi.
+ *      Wakes up on a fixed period and records how late each wakeup was
+ *      and how long a GPIO toggle took, optionally with busy threads
+ *      loading the other cores. Run it with and without real-time mode
+ *      to see what the real-time settings buy.
+ ***********************************************************************
+ */
+
+
+#include <pthread.h>
+#include <sched.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+#include "jitter_benchmark.hpp"
+
+
+namespace {
+    int64_t toNanoseconds(const struct timespec& time) {
+        return (int64_t)time.tv_sec * 1000000000LL + time.tv_nsec;
+    }
+
+    /**
+     * Gets the core the calling thread is pinned to.
+     * @returns the core, -1 if the thread may run on more than one core.
+     */
+    int pinnedCore() {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        if (pthread_getaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0 || CPU_COUNT(&cpus) != 1) {
+            return -1;
+        }
+        for (int core = 0; core < CPU_SETSIZE; core++) {
+            if (CPU_ISSET(core, &cpus)) {
+                return core;
+            }
+        }
+        return -1;
+    }
+
+    /** Keeps a core and the memory bus busy until told to stop, never on the benchmark core. */
+    void loadWorker(std::atomic<bool>& stop, std::atomic<int>& ready, int benchmarkCore) {
+        // Threads inherit the creator's scheduler and affinity, a busy SCHED_FIFO thread would starve
+        // the benchmark and in real-time mode would share its core.
+        struct sched_param param;
+        memset(&param, 0, sizeof(param));
+        pthread_setschedparam(pthread_self(), SCHED_OTHER, &param);
+
+        int cores = std::thread::hardware_concurrency();
+        if (benchmarkCore >= 0 && cores > 1) {
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            for (int core = 0; core < cores; core++) {
+                if (core != benchmarkCore) {
+                    CPU_SET(core, &cpus);
+                }
+            }
+            pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        }
+
+        const size_t SIZE = 8 * 1024 * 1024;
+        std::vector<char> source(SIZE, 1);
+        std::vector<char> destination(SIZE);
+        ready.fetch_add(1);
+        while (!stop.load(std::memory_order_relaxed)) {
+            memcpy(destination.data(), source.data(), SIZE);
+        }
+    }
+}
+
+JitterBenchmark::JitterBenchmark(GPIODriver& gpio, int togglePin) : gpio(gpio), togglePin(togglePin) {
+};
+
+void JitterBenchmark::run(int periodUs, int iterations, int loadThreads) {
+    // Allocated up front so the measurement loop never allocates.
+    wakeupLatency.assign(iterations, 0);
+    toggleLatency.assign(iterations, 0);
+
+    std::atomic<bool> stopLoad(false);
+    std::atomic<int> loadReady(0);
+    std::vector<std::thread> load;
+    int benchmarkCore = pinnedCore();
+    for (int i = 0; i < loadThreads; i++) {
+        load.emplace_back(loadWorker, std::ref(stopLoad), std::ref(loadReady), benchmarkCore);
+    }
+
+    // Measures only once every load thread is running.
+    while (loadReady.load() < loadThreads) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    struct timespec next;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+
+    for (int i = 0; i < iterations; i++) {
+        next.tv_nsec += periodUs * 1000L;
+        while (next.tv_nsec >= 1000000000L) {
+            next.tv_nsec -= 1000000000L;
+            next.tv_sec++;
+        }
+
+        // Absolute deadlines so time spent in the loop does not shift later wakeups.
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, nullptr);
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        wakeupLatency[i] = toNanoseconds(now) - toNanoseconds(next);
+
+        gpio.high(togglePin);
+        gpio.low(togglePin);
+        struct timespec toggled;
+        clock_gettime(CLOCK_MONOTONIC, &toggled);
+        toggleLatency[i] = toNanoseconds(toggled) - toNanoseconds(now);
+    }
+
+    stopLoad.store(true);
+    for (std::thread& thread : load) {
+        thread.join();
+    }
+};
+
+void JitterBenchmark::report() {
+    reportSamples("Wakeup latency", wakeupLatency);
+    reportSamples("GPIO toggle (high + low)", toggleLatency);
+};
+
+void JitterBenchmark::reportSamples(const char* name, std::vector<int64_t>& samples) {
+    if (samples.empty()) {
+        std::cout << name << ": no samples.\n";
+        return;
+    }
+
+    std::vector<int64_t> sorted(samples);
+    std::sort(sorted.begin(), sorted.end());
+
+    double mean = 0;
+    for (int64_t sample : sorted) {
+        mean += sample;
+    }
+    mean /= sorted.size();
+
+    auto percentile = [&sorted](double p) {
+        size_t index = (size_t)(p * (sorted.size() - 1));
+        return sorted[index] / 1000.0;
+    };
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << name << " (us), " << sorted.size() << " samples:\n";
+    std::cout << "    min " << sorted.front() / 1000.0 << "  mean " << mean / 1000.0
+              << "  p50 " << percentile(0.50) << "  p99 " << percentile(0.99)
+              << "  p99.9 " << percentile(0.999) << "  max " << sorted.back() / 1000.0 << "\n";
+
+    // Histogram buckets in microseconds, the last bucket holds everything above.
+    const int BUCKETS[8] = {1, 5, 10, 20, 50, 100, 500, 1000};
+    size_t counts[9] = {0};
+    for (int64_t sample : sorted) {
+        int bucket = 0;
+        while (bucket < 8 && sample >= BUCKETS[bucket] * 1000LL) {
+            bucket++;
+        }
+        counts[bucket]++;
+    }
+    for (int bucket = 0; bucket < 9; bucket++) {
+        if (bucket < 8) {
+            std::cout << "    <" << std::setw(5) << BUCKETS[bucket] << " us: ";
+        } else {
+            std::cout << "    >=" << std::setw(4) << BUCKETS[7] << " us: ";
+        }
+        std::cout << counts[bucket] << "\n";
+    }
+    std::cout << std::defaultfloat;
+};
@@ -0,0 +1,56 @@
+/*
+ * jitter_benchmark.hpp:
+ ***********************************************************************
+ * Measures scheduling jitter on the RPi.
+ *      Wakes up on a fixed period and records how late each wakeup was
+ *      and how long a GPIO toggle took, optionally with busy threads
+ *      loading the other cores. Run it with and without real-time mode
+ *      to see what the real-time settings buy.
+ ***********************************************************************
+ */
+
+
+#include <cstdint>
+#include <vector>
+
+#include "../hardware_drivers/gpio.hpp"
+
+#ifndef JITTERBENCHMARK
+#define JITTERBENCHMARK
+
+class JitterBenchmark {
+    private:
+        GPIODriver& gpio;
+
+        /** Pin toggled on every wakeup, must not be wired to anything on the fixture. */
+        const int togglePin;
+
+        /** Samples of the last run, in nanoseconds. */
+        std::vector<int64_t> wakeupLatency;
+        std::vector<int64_t> toggleLatency;
+
+        /** Prints the distribution of one set of samples. */
+        void reportSamples(const char* name, std::vector<int64_t>& samples);
+
+    public:
+        /**
+         * @param gpio a GPIO driver, already initialized.
+         * @param togglePin pin toggled on every wakeup, must not be wired to anything on the fixture.
+         */
+        JitterBenchmark(GPIODriver& gpio, int togglePin);
+
+        /**
+         * Runs the benchmark on the calling thread, configure the thread first to measure real-time mode.
+         * @param periodUs the wakeup period in microseconds.
+         * @param iterations number of wakeups.
+         * @param loadThreads number of busy threads run alongside to load the system.
+         */
+        void run(int periodUs, int iterations, int loadThreads);
+
+        /**
+         * Prints min, mean, percentiles, max and a histogram of the last run.
+         */
+        void report();
+};
+
+#endif
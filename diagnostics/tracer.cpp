@@ -0,0 +1,184 @@
+/*
+ * tracer.cpp:
+ ***********************************************************************
+ * Opt-in event tracer for the bus hot path.
+ *      Records timestamped begin/end events for CS assertions, SPI frames,
+ *      delays and controller calls into per-thread buffers, and exports
+ *      them as Chrome trace JSON which opens in chrome://tracing or
+ *      ui.perfetto.dev. While tracing is off each trace point costs a
+ *      single relaxed load.
+ ***********************************************************************
+ */
+
+
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <cstdio>
+#include <ctime>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "tracer.hpp"
+
+
+namespace {
+    /** A single recorded event. */
+    struct TraceEvent {
+        const char* name;
+        uint64_t timestamp;
+        int arg;
+        char phase;
+    };
+
+    /** Events recorded by one thread, only that thread writes to it. */
+    struct ThreadBuffer {
+        int tid;
+        const char* name;
+        std::vector<TraceEvent> events;
+        std::atomic<size_t> count;
+        std::atomic<size_t> dropped;
+
+        /** Begin events still waiting for their end, each keeps one slot free. */
+        size_t open;
+    };
+
+    /** Every buffer ever created, only locked when a thread records for the first time and on export. */
+    std::mutex registryLock;
+    std::vector<std::unique_ptr<ThreadBuffer>> registry;
+
+    thread_local ThreadBuffer* threadBuffer = nullptr;
+
+    uint64_t nowNanoseconds() {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+    }
+
+    /** Gets the calling thread's buffer, creating it the first time the thread records or registers. */
+    ThreadBuffer* buffer(size_t eventsPerThread) {
+        if (threadBuffer == nullptr) {
+            std::unique_ptr<ThreadBuffer> created(new ThreadBuffer());
+            created->tid = syscall(SYS_gettid);
+            created->name = nullptr;
+            // Value initialized, so every page is touched here rather than by the events.
+            created->events.resize(eventsPerThread);
+            created->count.store(0);
+            created->dropped.store(0);
+            created->open = 0;
+
+            std::lock_guard<std::mutex> guard(registryLock);
+            threadBuffer = created.get();
+            registry.push_back(std::move(created));
+        }
+        return threadBuffer;
+    }
+
+    /**
+     * Appends an event to the calling thread's buffer.
+     * @returns false if a begin event was dropped, ends always fit since begin keeps a slot for them.
+     */
+    bool record(const char* name, char phase, int arg, size_t eventsPerThread) {
+        ThreadBuffer* events = buffer(eventsPerThread);
+        size_t index = events->count.load(std::memory_order_relaxed);
+        if (phase == 'B') {
+            // The begin itself, its end and the ends of the events already open.
+            if (index + events->open + 2 > events->events.size()) {
+                events->dropped.fetch_add(2, std::memory_order_relaxed);
+                return false;
+            }
+            events->open++;
+        } else {
+            // An end whose begin was recorded before the last start has nothing to close.
+            if (events->open == 0 || index >= events->events.size()) {
+                return true;
+            }
+            events->open--;
+        }
+        TraceEvent& event = events->events[index];
+        event.name = name;
+        event.timestamp = nowNanoseconds();
+        event.arg = arg;
+        event.phase = phase;
+        events->count.store(index + 1, std::memory_order_release);
+        return true;
+    }
+}
+
+std::atomic<bool> Tracer::tracing(false);
+std::atomic<size_t> Tracer::eventsPerThread(Tracer::DEFAULT_EVENTS_PER_THREAD);
+
+void Tracer::start(size_t events) {
+    {
+        std::lock_guard<std::mutex> guard(registryLock);
+        for (std::unique_ptr<ThreadBuffer>& threadEvents : registry) {
+            if (threadEvents->events.size() != events) {
+                std::vector<TraceEvent>(events).swap(threadEvents->events);
+            }
+            threadEvents->count.store(0, std::memory_order_relaxed);
+            threadEvents->dropped.store(0, std::memory_order_relaxed);
+            threadEvents->open = 0;
+        }
+    }
+    eventsPerThread.store(events, std::memory_order_relaxed);
+    buffer(events);
+    tracing.store(true, std::memory_order_release);
+};
+
+void Tracer::stop() {
+    tracing.store(false, std::memory_order_release);
+};
+
+bool Tracer::begin(const char* name, int arg) {
+    return record(name, 'B', arg, eventsPerThread.load(std::memory_order_relaxed));
+};
+
+void Tracer::end(const char* name) {
+    record(name, 'E', -1, eventsPerThread.load(std::memory_order_relaxed));
+};
+
+void Tracer::nameThread(const char* name) {
+    buffer(eventsPerThread.load(std::memory_order_relaxed))->name = name;
+};
+
+int Tracer::exportChromeTrace(const std::string& path) {
+    FILE* out = fopen(path.c_str(), "w");
+    if (out == nullptr) {
+        return -1;
+    }
+
+    std::lock_guard<std::mutex> guard(registryLock);
+    int pid = getpid();
+    bool first = true;
+
+    fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    for (std::unique_ptr<ThreadBuffer>& threadEvents : registry) {
+        if (threadEvents->name != nullptr) {
+            fprintf(out, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                    first ? "" : ",\n", pid, threadEvents->tid, threadEvents->name);
+            first = false;
+        }
+
+        size_t count = threadEvents->count.load(std::memory_order_acquire);
+        for (size_t i = 0; i < count; i++) {
+            const TraceEvent& event = threadEvents->events[i];
+            // Chrome trace timestamps are microseconds, the fraction keeps nanosecond resolution.
+            fprintf(out, "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d",
+                    first ? "" : ",\n", event.name, event.phase, event.timestamp / 1000.0, pid, threadEvents->tid);
+            if (event.arg != -1) {
+                fprintf(out, ",\"args\":{\"arg\":%d}", event.arg);
+            }
+            fprintf(out, "}");
+            first = false;
+        }
+
+        size_t dropped = threadEvents->dropped.load(std::memory_order_relaxed);
+        if (dropped > 0) {
+            std::cout << "Tracer: thread " << threadEvents->tid << " dropped " << dropped << " events, its buffer was full.\n";
+        }
+    }
+    fprintf(out, "\n]}\n");
+
+    return fclose(out) == 0 ? 0 : -1;
+};
@@ -0,0 +1,106 @@
+/*
+ * tracer.hpp:
+ ***********************************************************************
+ * Opt-in event tracer for the bus hot path.
+ *      Records timestamped begin/end events for CS assertions, SPI frames,
+ *      delays and controller calls into per-thread buffers, and exports
+ *      them as Chrome trace JSON which opens in chrome://tracing or
+ *      ui.perfetto.dev. While tracing is off each trace point costs a
+ *      single relaxed load.
+ ***********************************************************************
+ */
+
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#ifndef TRACER
+#define TRACER
+
+class Tracer {
+    private:
+        /** Set while tracing, read at every trace point. */
+        static std::atomic<bool> tracing;
+
+        /** Buffer size handed to threads that start recording. */
+        static std::atomic<size_t> eventsPerThread;
+
+    public:
+        /** Default number of events each thread can record before new events are dropped, 24 MB per thread. */
+        static const size_t DEFAULT_EVENTS_PER_THREAD = 1 << 20;
+
+        /**
+         * Starts recording, clears anything recorded by an earlier start.
+         * Buffers of threads that already recorded are resized to eventsPerThread, and the calling
+         * thread's buffer is allocated now. Should be called while no other thread is recording.
+         * @param eventsPerThread number of events each thread can record.
+         */
+        static void start(size_t eventsPerThread = DEFAULT_EVENTS_PER_THREAD);
+
+        /** Stops recording, recorded events are kept until the next start. */
+        static void stop();
+
+        /** @returns true while recording. */
+        static bool enabled() {
+            return tracing.load(std::memory_order_relaxed);
+        }
+
+        /**
+         * Records the start of an event on the calling thread.
+         * Room for the end of every open event is kept, so an event is either recorded with its end or dropped whole.
+         * @param name the event name, must be a string literal or otherwise outlive the tracer.
+         * @param arg a value shown with the event, e.g. the CS pin.
+         * @returns false if the event was dropped, end must then not be called for it.
+         */
+        static bool begin(const char* name, int arg = -1);
+
+        /**
+         * Records the end of the most recent event on the calling thread, only if its begin was recorded.
+         * @param name the event name, the same as passed to begin.
+         */
+        static void end(const char* name);
+
+        /**
+         * Names the calling thread in the exported trace and allocates its buffer.
+         * Threads should call it before their traced work, otherwise the buffer is allocated by
+         * their first event, in the middle of the traced path.
+         * @param name the thread name, must be a string literal or otherwise outlive the tracer.
+         */
+        static void nameThread(const char* name);
+
+        /**
+         * Writes every recorded event as Chrome trace JSON. Call after stop.
+         * @param path the output file.
+         * @returns -1 if the file could not be written.
+         */
+        static int exportChromeTrace(const std::string& path);
+};
+
+/** Records a begin event now and the matching end event when the scope exits. */
+class TraceScope {
+    private:
+        const char* name;
+        bool active;
+
+    public:
+        TraceScope(const char* name, int arg = -1) : name(name), active(Tracer::enabled() && Tracer::begin(name, arg)) {
+        }
+
+        ~TraceScope() {
+            if (active) {
+                Tracer::end(name);
+            }
+        }
+
+        TraceScope(const TraceScope&) = delete;
+        TraceScope& operator=(const TraceScope&) = delete;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+/** Traces the rest of the enclosing scope, optionally with an int argument. */
+#define TRACE_SCOPE(...) TraceScope TRACE_CONCAT(traceScope, __LINE__)(__VA_ARGS__)
+
+#endif
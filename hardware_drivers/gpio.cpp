@@ -10,13 +10,17 @@
 
 #include <wiringPi.h>
 #include <iostream>
+#include <algorithm>
 
 #include "gpio.hpp"
 
 
-int GPIODriver::initGPIO() {
+int GPIODriver::initGPIO(const std::vector<int>& reservedPins) {
     // Sets all GPIO pins to OUTPUT mode and turns them LOW.
     for (int pin : GPIO_OUTPUT_PINS) {
+        if (std::find(reservedPins.begin(), reservedPins.end(), pin) != reservedPins.end()) {
+            continue;
+        }
         pinMode(pin, OUTPUT);
         digitalWrite(pin, LOW);
     }
@@ -24,6 +28,9 @@ int GPIODriver::initGPIO() {
     // Checks if all GPIO pins are correctly set to LOW.
     bool pinsIntialized = true;
     for (int pin : GPIO_OUTPUT_PINS) {
+        if (std::find(reservedPins.begin(), reservedPins.end(), pin) != reservedPins.end()) {
+            continue;
+        }
         if (digitalRead(pin) != LOW) {
             std::cout << "GPIO pin: " << pin << " failed to initialize correctly.\n";
             pinsIntialized = false;
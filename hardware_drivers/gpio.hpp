@@ -11,24 +11,41 @@
 #ifndef GPIODRIVER
 #define GPIODRIVER
 
+#include <vector>
+
 class GPIODriver {
     private:
-        /** All GPIO pins that have OUTPUT pin mode function. */
-        const int GPIO_OUTPUT_PINS[22] = {0,1,2,3,4,5,6,7,8,9,11,15,16,21,22,23,24,25,26,27,28,29};
-
         /** All GPIO pins that have ALTERNATE pin mode function. */
         const int GPIO_ALT_PINS[4] = {10,12,13,14};
         
     public:
+        /** All GPIO pins that have OUTPUT pin mode function, every CS and CNV pin must be one of them. */
+        static constexpr int GPIO_OUTPUT_PINS[22] = {0,1,2,3,4,5,6,7,8,9,11,15,16,21,22,23,24,25,26,27,28,29};
+
+        /**
+         * @param pin a wiringPi pin number.
+         * @returns true if the pin is set up as an output by initGPIO.
+         */
+        static bool isOutputPin(int pin) {
+            for (int outputPin : GPIO_OUTPUT_PINS) {
+                if (outputPin == pin) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
         /**
          * Ensures proper initialization of WiringPi GPIO driver.
          * Changes pin mode of all GPIO pins to ensure they are in correct operation. 
+         * @param reservedPins pins left untouched, e.g. pins muxed to a second SPI bus.
          * @returns -1 if initialization failed.
          */
-        int initGPIO();
+        int initGPIO(const std::vector<int>& reservedPins = {});
 
         /**
          * Turns a GPIO pin high.
+         * Safe to call from multiple threads as long as they use different pins.
          * @param pin indicates pin to be turned high.
          */
         void high(int pin);
@@ -12,11 +12,30 @@
 #include <wiringPiSPI.h>
 
 #include "spi.hpp"
+#include "../diagnostics/tracer.hpp"
 
 
+SPIDriver::SPIDriver(int bus, int channel, const int (&chipSelects)[CHIP_SELECT_COUNT])
+    : SPI_BUS(bus), SPI_CHANNEL(channel),
+      SPI_CHIP_SELECTS{chipSelects[0], chipSelects[1], chipSelects[2], chipSelects[3], chipSelects[4]} {
+};
+
+std::vector<int> SPIDriver::busPins(int bus) {
+    std::vector<int> pins;
+    if (bus < 0 || bus > MAX_BUS) {
+        return pins;
+    }
+    for (int pin : BUS_PINS[bus]) {
+        if (pin != -1) {
+            pins.push_back(pin);
+        }
+    }
+    return pins;
+};
+
 int SPIDriver::initSPI() {
-    // Enables SPI functionality.
-    if (wiringPiSPISetup(SPI_CHANNEL_0, SPI_BAUDRATE) < 0) {
+    // Enables SPI functionality, mode 0 is the same mode wiringPiSPISetup uses.
+    if (wiringPiSPIxSetupMode(SPI_BUS, SPI_CHANNEL, SPI_BAUDRATE, 0) < 0) {
         return -1;
     }   
 
@@ -29,5 +48,6 @@ int SPIDriver::initSPI() {
 };
 
 int SPIDriver::readWrite(unsigned char* data, int len) {
-    return wiringPiSPIDataRW(SPI_CHANNEL_0, data, len);
+    TRACE_SCOPE("spi.readWrite", len);
+    return wiringPiSPIxDataRW(SPI_BUS, SPI_CHANNEL, data, len);
 };
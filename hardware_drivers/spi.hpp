@@ -11,6 +11,8 @@
 #ifndef SPIDRIVER
 #define SPIDRIVER
 
+#include <vector>
+
 // DEBUG -- CAN BE USED TO PRINT INDIVIDUAL BITS OF A BYTE, with printf
 #define BIN "%c%c%c%c%c%c%c%c"
 #define BINS(byte) \
@@ -28,14 +30,59 @@ class SPIDriver {
         /** SPI baudrate defines speed of data over the bus. Set to 8 Mhz. */
         const int SPI_BAUDRATE = 8000000;
 
+        /** SPI bus number, the x in /dev/spidevx.y. */
+        const int SPI_BUS = 0;
+
         /** Enabling SPI channel also starts automatic control of pin 10 as CS. */
-        const int SPI_CHANNEL_0 = 0;
+        const int SPI_CHANNEL = 0;
 
         /** Defines pins used as CS on the RaspberryPi. */
         const int SPI_AUTO_CHIP_SELECTS[1] = {10}; // DO NOT USE
         const int SPI_CHIP_SELECTS[5] = {21,22,23,24,25};
 
     public:
+        /** Number of CS pins each SPI bus drives. */
+        static const int CHIP_SELECT_COUNT = 5;
+
+        /** Highest SPI bus number, the RPi 4 and 5 have buses 0-6. */
+        static const int MAX_BUS = 6;
+
+        /**
+         * MISO, MOSI, SCLK, then the CEs of every SPI bus, in wiringPi numbering, padded with -1.
+         * From the BCM2711/BCM2712 pin functions. Bus 2 is not brought out to the 40 pin header.
+         * Also used at compile time by the device handles, see device_handle.hpp.
+         */
+        static constexpr int BUS_PINS[MAX_BUS + 1][6] = {
+            {13, 12, 14, 10, 11, -1},
+            {24, 28, 29, 1, 0, 27},
+            {-1, -1, -1, -1, -1, -1},
+            {31, 8, 9, 30, 5, -1},
+            {21, 22, 11, 7, 6, -1},
+            {23, 15, 16, 26, 25, -1},
+            {24, 28, 29, 1, 2, -1}
+        };
+
+        /**
+         * Gets the pins a SPI bus takes over once enabled, MISO, MOSI, SCLK and its hardware CEs.
+         * None of them can be used as a CS or any other GPIO while the bus is in use.
+         * @param bus the SPI bus number, 0-MAX_BUS.
+         * @returns the wiringPi numbers of the pins, empty if the bus does not exist.
+         */
+        static std::vector<int> busPins(int bus);
+
+        /**
+         * Uses the default fixture wiring, bus 0 channel 0 with CS pins 21-25.
+         */
+        SPIDriver() = default;
+
+        /**
+         * Uses another SPI bus, allows more than one fixture to be driven from a single RPi.
+         * @param bus the SPI bus number, the x in /dev/spidevx.y.
+         * @param channel the SPI channel on the bus, the y in /dev/spidevx.y.
+         * @param chipSelects the CS pins of the devices on this bus.
+         */
+        SPIDriver(int bus, int channel, const int (&chipSelects)[CHIP_SELECT_COUNT]);
+
         /**
          * Ensures proper initialization of WiringPi SPI driver.
          * Changes all SPI CS pins to HIGH to deselect SPI devices on initialization. 
@@ -45,6 +92,7 @@ class SPIDriver {
 
         /**
          * SPI command to read and write over the SPI bus.
+         * Only one thread may use a SPI bus at a time.
          * @param data holds data being trasmitted and data being recieved.
          * @param len indicates the length of data.
          * @returns -1 if read/write failed.
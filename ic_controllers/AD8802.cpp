@@ -13,41 +13,83 @@
 #include "AD8802.hpp"
 #include "../hardware_drivers/spi.hpp"
 #include "../hardware_drivers/gpio.hpp"
+#include "device_handle.hpp"
+#include "../diagnostics/tracer.hpp"
+
+AD8802Controller::AD8802Controller(int dac1Cs, int dac2Cs)
+    : DAC_1_CS(dac1Cs), DAC_2_CS(dac2Cs) {
+};
 
 int AD8802Controller::initAD8802(SPIDriver& spi, GPIODriver& gpio) {
     // Sets all voltages to 0 initially.
-    for (int dacOut = 0; dacOut < 11; dacOut++) {
-        applyVoltage(spi, gpio, dacOut, 0.0, DAC_1_CS);
-        applyVoltage(spi, gpio, dacOut, 0.0, DAC_2_CS);
+    int result = 0;
+    for (int dacOut = 0; dacOut < 12; dacOut++) {
+        result |= applyVoltage(spi, gpio, dacOut, 0.0, DAC_1_CS);
+        result |= applyVoltage(spi, gpio, dacOut, 0.0, DAC_2_CS);
     }
-    return 0;
+    return result == 0 ? 0 : -1;
 };
 
-void AD8802Controller::applyVoltage(SPIDriver& spi, GPIODriver& gpio, int dacOutput, double voltage, int cs) {
-    // Get voltage input data for the DAC and combine it with the output address.
-    uint16_t dataRaw = dacInputData(voltage);
-    dataRaw = dataRaw << 8;
-    dataRaw = dataRaw | DAC_OUTPUT_ADDRESSES[dacOutput];
+void AD8802Controller::setBusOwner(BusOwner* owner) {
+    busOwner = owner;
+};
 
-    uint8_t data[2];
-    // Sends 4 address bits. 
-    data[0] = dataRaw & 0x0F;
-    // The last 8 value bits read.
-    data[1] = (dataRaw >> 8) & 0xFF;
+int AD8802Controller::applyVoltage(SPIDriver& spi, GPIODriver& gpio, int dacOutput, double voltage, int cs) {
+    if (busOwner != nullptr && !busOwner->mayAccessBus()) {
+        return busOwner->runOnBus([&]() { return applyVoltage(spi, gpio, dacOutput, voltage, cs); });
+    }
+    TRACE_SCOPE("AD8802.applyVoltage", dacOutput);
+    int code = dacInputData(cs, dacOutput, voltage);
+    if (code == -1) {
+        return -1;
+    }
+    return applyCode(spi, gpio, dacOutput, code, cs);
+};
+
+void AD8802Controller::setCalibration(const CalibrationTable* table) {
+    calibration = table;
+};
 
-    // Sends SPI data to apply voltage.
-    gpio.low(cs);
-    if (spi.readWrite(data, 2) == -1) {
-        return;
+int AD8802Controller::applyCode(SPIDriver& spi, GPIODriver& gpio, int dacOutput, uint8_t code, int cs) {
+    if (busOwner != nullptr && !busOwner->mayAccessBus()) {
+        return busOwner->runOnBus([&]() { return applyCode(spi, gpio, dacOutput, code, cs); });
+    }
+    TRACE_SCOPE("AD8802.applyCode", dacOutput);
+    // Any other pin could be the CS of another chip, which would take the DAC command as its own.
+    if (dacIndex(cs) == -1) {
+        return -1;
     }
-    gpio.high(cs);
+    AD8802Handle<DriverBackend, RuntimeCs<CS_DAC>> handle(DriverBackend(spi, gpio), {cs});
+    return handle.applyCode(DAC_OUTPUT_ADDRESSES[dacOutput], code);
 };
 
 uint16_t AD8802Controller::dacInputData(double voltage) {
-    // Calculates closest matching value in the increment from 0-255 for given voltage.
-    uint16_t inputValue = (uint16_t)(std::round((voltage/MAX_OUTPUT_VOLTAGE)*DAC_DIVISON_FACTOR));
-    // Clamps output to max value.
-    inputValue = inputValue > MAX_INPUT_VALUE ? MAX_INPUT_VALUE : inputValue;
+    return idealDacCode(voltage);
+};
+
+int AD8802Controller::dacInputData(int cs, int dacOutput, double voltage) {
+    // Any other pin would read another DAC's calibration.
+    int dac = dacIndex(cs);
+    if (dac == -1) {
+        return -1;
+    }
+    // A calibrated output is a single table read.
+    if (calibration != nullptr) {
+        return calibration->code(dac, dacOutput, voltage);
+    }
+    return dacInputData(voltage);
+};
+
+int AD8802Controller::dacIndex(int cs) {
+    if (cs == DAC_1_CS) {
+        return 0;
+    }
+    if (cs == DAC_2_CS) {
+        return 1;
+    }
+    return -1;
+};
 
-    return inputValue;
+int AD8802Controller::chipSelect(int dac) {
+    return dac == 0 ? DAC_1_CS : DAC_2_CS;
 };
\ No newline at end of file
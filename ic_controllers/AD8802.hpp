@@ -13,6 +13,9 @@
 
 #include "../hardware_drivers/spi.hpp"
 #include "../hardware_drivers/gpio.hpp"
+#include "calibration_table.hpp"
+#include "dac_transfer.hpp"
+#include "bus_owner.hpp"
 
 #ifndef AD8802CONTROLLER
 #define AD8802CONTROLLER
@@ -55,26 +58,28 @@ class AD8802Controller {
             [DAC_OUTPUT_12] = 0x0B
         };
 
-        /** Max voltage output. */
-        const double MAX_OUTPUT_VOLTAGE = 5.0; // IMPORTANT VALUE, ENSURE CORRECTNESS
-
-        /** Max value that can be sent over SPI for DAC control. 8-bit. */
-        const int MAX_INPUT_VALUE = 255;
+        /** Measured transfer functions, nullptr to assume the ideal transfer function. */
+        const CalibrationTable* calibration = nullptr;
 
-        /** Value that the DAC divides input value by to get voltage output. */
-        const int DAC_DIVISON_FACTOR = 256;
+        /** Thread owning the bus, nullptr if the bus is accessed from the calling thread. */
+        BusOwner* busOwner = nullptr;
 
-        /** 
-         * Calculates the value that needs to be sent to the DAC for a desired voltage.
-         * @param voltage the desired voltage output from the DAC.
-         * @returns a value from 0-255 to be sent as input to the DAC.
-         */
-        uint16_t dacInputData(double voltage);
-    
     public:
         /** CS used for ZIF pins. */
         static const int DAC_CS = 23;
 
+        /**
+         * Uses the default fixture wiring, DAC CS pins 23 and 24.
+         */
+        AD8802Controller() = default;
+
+        /**
+         * Uses other DAC CS pins, for fixtures not wired to the default pins.
+         * @param dac1Cs chip select of DAC 1.
+         * @param dac2Cs chip select of DAC 2.
+         */
+        AD8802Controller(int dac1Cs, int dac2Cs);
+
         /**
          * Completes proper intialization procedure to ensure AD8802 board is in ready state.
          * Ensures DAC is reset.
@@ -84,6 +89,22 @@ class AD8802Controller {
          */
         int initAD8802(SPIDriver& spi, GPIODriver& gpio);
 
+        /** Max voltage output. */
+        static constexpr double MAX_VOLTAGE = AD8802_MAX_VOLTAGE;
+
+        /**
+         * Uses measured transfer functions instead of the ideal one when converting voltages.
+         * @param table a loaded calibration table, or nullptr to go back to the ideal transfer function.
+         */
+        void setCalibration(const CalibrationTable* table);
+
+        /**
+         * Attaches the controller to the thread owning the bus. Its blocking methods called from
+         * other threads then run on that thread.
+         * @param owner the bus owner, or nullptr to access the bus from the calling thread.
+         */
+        void setBusOwner(BusOwner* owner);
+
         /**
          * Applies a given voltage to the DAC output specified.
          * @param spi a SPI diver.
@@ -91,8 +112,51 @@ class AD8802Controller {
          * @param dacOutput the DAC output channel, 0-11.
          * @param voltage the desired voltage to be applied, 0-5V.
          * @param cs the cs of the desired DAC.
+         * @returns -1 if cs is not the CS of one of the DACs or the transfer failed.
+         */
+        int applyVoltage(SPIDriver& spi, GPIODriver& gpio, int dacOutput, double voltage, int cs);
+
+        /**
+         * Applies a precomputed DAC input value to the DAC output specified.
+         * @param spi a SPI diver.
+         * @param gpio a GPIO driver.
+         * @param dacOutput the DAC output channel, 0-11.
+         * @param code the DAC input value, 0-255, as returned by dacInputData.
+         * @param cs the cs of the desired DAC.
+         * @returns -1 if cs is not the CS of one of the DACs or the transfer failed.
+         */
+        int applyCode(SPIDriver& spi, GPIODriver& gpio, int dacOutput, uint8_t code, int cs);
+
+        /** 
+         * Calculates the value that needs to be sent to the DAC for a desired voltage, see idealDacCode.
+         * @param voltage the desired voltage output from the DAC.
+         * @returns a value from 0-255 to be sent as input to the DAC.
+         */
+        uint16_t dacInputData(double voltage);
+
+        /**
+         * Calculates the value that needs to be sent to a DAC output for a desired voltage,
+         * using the calibration when one is set.
+         * @param cs the cs of the desired DAC.
+         * @param dacOutput the DAC output channel, 0-11.
+         * @param voltage the desired voltage output from the DAC.
+         * @returns a value from 0-255 to be sent as input to the DAC, -1 if cs is not the CS of one of the DACs.
+         */
+        int dacInputData(int cs, int dacOutput, double voltage);
+
+        /**
+         * Gets which DAC a CS pin selects.
+         * @param cs a CS pin.
+         * @returns the DAC, 0 or 1, -1 if the pin is not the CS of either DAC.
+         */
+        int dacIndex(int cs);
+
+        /**
+         * Gets the CS pin of one of the DACs.
+         * @param dac the DAC, 0 or 1.
+         * @returns the CS pin of the DAC.
          */
-        void applyVoltage(SPIDriver& spi, GPIODriver& gpio, int dacOutput, double voltage, int cs);
+        int chipSelect(int dac);
 };
 
 #endif
\ No newline at end of file
@@ -14,36 +14,54 @@
 #include "LTC2380.hpp"
 #include "../hardware_drivers/spi.hpp"
 #include "../hardware_drivers/gpio.hpp"
+#include "device_handle.hpp"
+#include "../diagnostics/tracer.hpp"
+
+LTC2380Controller::LTC2380Controller(int cs, int cnv)
+    : LTC2380_CS(cs), LTC2380_CNV(cnv) {
+};
 
 int LTC2380Controller::initLTC2380(SPIDriver& spi, GPIODriver& gpio) {
     return 0;
 };
 
+void LTC2380Controller::setBusOwner(BusOwner* owner) {
+    busOwner = owner;
+}
+
 int LTC2380Controller::read(SPIDriver& spi, GPIODriver& gpio, bool voltage) {
-    // Trigger conversion and ensure the trigger is on for adequate time.
-    gpio.high(LTC2380_CNV);
-    delayNanoseconds(30);
-    gpio.low(LTC2380_CNV);
-
-    uint8_t data[5];
-
-    // Enable SDO and read the output from ADC.
-    //    First 24 bits are the result, the last 16 are the number of samples averaged.
-    //    Might have to tie the SPI read to wait on the BUSY pin on the ADC going low, otherwise it may be misaligned.
-    gpio.low(LTC2380_CS);
-    if (spi.readWrite(data, 5) == -1) {
+    if (busOwner != nullptr && !busOwner->mayAccessBus()) {
+        return busOwner->runOnBus([&]() { return read(spi, gpio, voltage); });
+    }
+    TRACE_SCOPE("LTC2380.read");
+    int value;
+    if (readRaw(spi, gpio, value) == -1) {
+        return -1;
+    }
+    return scale(value, voltage);
+}
+
+int LTC2380Controller::readRaw(SPIDriver& spi, GPIODriver& gpio) {
+    int raw;
+    if (readRaw(spi, gpio, raw) == -1) {
         return -1;
     }
-    gpio.high(LTC2380_CS);
+    return raw;
+}
 
-    // Concatenate the result back into 1 integer.
-    int value = data[0] << 24 | data[1] << 16 | data[2] << 8;
-    // Takes care of sign extension because output is in two's complement (signed).
-    value = value >> 8;
+int LTC2380Controller::readRaw(SPIDriver& spi, GPIODriver& gpio, int& raw) {
+    if (busOwner != nullptr && !busOwner->mayAccessBus()) {
+        return busOwner->runOnBus([&]() { return readRaw(spi, gpio, raw); });
+    }
+    TRACE_SCOPE("LTC2380.readRaw");
+    LTC2380Handle<DriverBackend, RuntimeCs<CS_ADC>, -1> handle(DriverBackend(spi, gpio), {LTC2380_CS}, LTC2380_CNV);
+    return handle.readRaw(raw);
+}
 
+int LTC2380Controller::scale(int value, bool voltage) {
     if (voltage) {
         value = value*VOLTAGE_MULTIPLY;
-        value = value*VOLTAGE_ERROR_OFFSET;
+        value = value*voltageGain;
     } else {
         value = value/CURRENT_DIVIDE;
         value = value*CURRENT_MULTIPLY;
@@ -52,11 +70,14 @@ int LTC2380Controller::read(SPIDriver& spi, GPIODriver& gpio, bool voltage) {
     return value;
 }
 
-// Estimated nanosecond delay.
-//    Each instruction takes 1/2.4 GHz (CPU processor speed for RPi5) or ~0.417 ns, so x2.4 = 1 ns.
-//    nop is a no operation assembly instruction that should take ~1 cycle.
-void LTC2380Controller::delayNanoseconds(int howLong) {
-    for (int i = 0; i < howLong*2.4; i++) {
-        asm volatile("nop");
-    }
-}
\ No newline at end of file
+double LTC2380Controller::rawToVolts(int raw) {
+    return raw/FULL_SCALE_CODE*REFERENCE_VOLTAGE*VOLTAGE_MULTIPLY;
+}
+
+void LTC2380Controller::setVoltageGain(double gain) {
+    voltageGain = gain;
+}
+
+double LTC2380Controller::getVoltageGain() {
+    return voltageGain;
+}
@@ -10,6 +10,7 @@
 
 #include "../hardware_drivers/gpio.hpp"
 #include "../hardware_drivers/spi.hpp"
+#include "bus_owner.hpp"
 
 #ifndef LTC2380CONTROLLER
 #define LTC2380CONTROLLER
@@ -25,19 +26,40 @@ class LTC2380Controller {
         /** The multiplier for the voltage measurement. */
         const double VOLTAGE_MULTIPLY = 20.0;
 
-        /** 2.3% consistent error offset. */
+        /** 2.3% consistent error offset, used until a calibration sets voltageGain. */
         const double VOLTAGE_ERROR_OFFSET = 1.023;
 
+        /** Voltage gain correction applied to every voltage reading. */
+        double voltageGain = VOLTAGE_ERROR_OFFSET;
+
+        /** ADC reference voltage, full scale is +-REFERENCE_VOLTAGE at the ADC pins. */
+        const double REFERENCE_VOLTAGE = 5.0; // IMPORTANT VALUE, ENSURE CORRECTNESS
+
+        /** Full scale of the 24-bit signed conversion result. */
+        const double FULL_SCALE_CODE = 8388608.0;
+
         /** The divisor for the current measurement. */
         const double CURRENT_DIVIDE = 7.995;
 
         /** The multiplier for the current measurement. */
         const double CURRENT_MULTIPLY = 10.0;
 
-        /** An estimated nanosecond delay function. */
-        void delayNanoseconds(int howLong);
+        /** Thread owning the bus, nullptr if the bus is accessed from the calling thread. */
+        BusOwner* busOwner = nullptr;
 
     public:
+        /**
+         * Uses the default fixture wiring, CS pin 25 and CNV pin 29.
+         */
+        LTC2380Controller() = default;
+
+        /**
+         * Uses other ADC pins, for fixtures not wired to the default pins.
+         * @param cs the SDI pin of the ADC used as a CS.
+         * @param cnv the conversion start pin.
+         */
+        LTC2380Controller(int cs, int cnv);
+
         /**
          * Completes proper intialization procedure to ensure LTC2380 board is in ready state.
          * Ensures DAC is reset.
@@ -47,6 +69,13 @@ class LTC2380Controller {
          */
         int initLTC2380(SPIDriver& spi, GPIODriver& gpio);
 
+        /**
+         * Attaches the controller to the thread owning the bus. Its blocking methods called from
+         * other threads then run on that thread.
+         * @param owner the bus owner, or nullptr to access the bus from the calling thread.
+         */
+        void setBusOwner(BusOwner* owner);
+
         /** 
          * Read the current input on the ADC.
          * @param spi a SPI diver.
@@ -55,6 +84,48 @@ class LTC2380Controller {
          * @returns the value read from the ADC.
          */
         int read(SPIDriver& spi, GPIODriver& gpio, bool voltage);
+
+        /** 
+         * Read the raw conversion result from the ADC, without any scaling.
+         * @param spi a SPI diver.
+         * @param gpio a GPIO driver.
+         * @returns the signed 24-bit conversion result, -1 if the read failed.
+         *     -1 is also a valid result, use the other readRaw where the two must be told apart.
+         */
+        int readRaw(SPIDriver& spi, GPIODriver& gpio);
+
+        /** 
+         * Read the raw conversion result from the ADC, without any scaling.
+         * @param spi a SPI diver.
+         * @param gpio a GPIO driver.
+         * @param raw set to the signed 24-bit conversion result.
+         * @returns -1 if the read failed.
+         */
+        int readRaw(SPIDriver& spi, GPIODriver& gpio, int& raw);
+
+        /**
+         * Scales a raw conversion result the same way read does.
+         * @param raw the raw conversion result from readRaw.
+         * @param voltage indicates whether the reading is for voltage or current.
+         * @returns the scaled value.
+         */
+        int scale(int raw, bool voltage);
+
+        /**
+         * Converts a raw conversion result to the voltage at the measurement input, without the gain correction.
+         * @param raw the raw conversion result from readRaw.
+         * @returns the voltage.
+         */
+        double rawToVolts(int raw);
+
+        /**
+         * Replaces the hand-tuned voltage gain correction with a calibrated one.
+         * @param gain the voltage gain correction.
+         */
+        void setVoltageGain(double gain);
+
+        /** @returns the voltage gain correction currently applied. */
+        double getVoltageGain();
         
 };
 
@@ -13,6 +13,7 @@
 
 #include "../hardware_drivers/spi.hpp"
 #include "../hardware_drivers/gpio.hpp"
+#include "bus_owner.hpp"
 
 #ifndef MCP23S17CONTROLLER
 #define MCP23S17CONTROLLER
@@ -87,64 +88,22 @@ class MCP23S17Controller {
             [PRIMARY_EXPANDER_2] = 22
         };
 
-        /** Opcodes necessary to communicate with the primary and secondary expanders. */
-        const int PRIMARY_WRITE_OPCODE = 0x42;
-        const int PRIMARY_READ_OPCODE = 0x43;
-        const int SECONDARY_WRITE_OPCODE = 0x40;
-        const int SECONDARY_READ_OPCODE = 0x41;
-
-        /** 
-         * Writes a 1 byte value to all present primary expanders.
-         * @param spi a SPI driver.
-         * @param gpio a GPIO driver.
-         * @param regAdress the MCP register address that needs to be written to.
-         * @param value the 1 byte data being written. 
-         */
-        void primaryWrite(SPIDriver& spi, GPIODriver& gpio, uint8_t regAdress, uint8_t value);
-
-        /** 
-         * Writes a 1 byte value to the selected primary expander.
-         * @param spi a SPI driver.
-         * @param gpio a GPIO driver.
-         * @param regAdress the MCP register address that needs to be written to.
-         * @param value the 1 byte data being written.
-         * @param CS chip select of the primary expander being written to.
-         */
-        void primaryWrite(SPIDriver& spi, GPIODriver& gpio, uint8_t regAdress, uint8_t value, int CS);
-
-        /** 
-         * Reads a 1 byte value to the selected primary expander.
-         * @param spi a SPI driver.
-         * @param gpio a GPIO driver.
-         * @param regAdress the MCP register address that needs to be read from.
-         * @param CS chip select of the primary expander being read from.
-         * @return the 1 byte data read from the device.
-         */
-        uint8_t primaryRead(SPIDriver& spi, GPIODriver& gpio, uint8_t regAdress, int CS);
+        /** Thread owning the bus, nullptr if the bus is accessed from the calling thread. */
+        BusOwner* busOwner = nullptr;
 
+    public:
         /**
-         * Writes a 1 byte message to all secondary expanders with CS low. 
-         * IMPORTANT - that only one secondary expander has CS low at a time.
-         * Otherwise devices may recieve unwanted commands.
-         * @param spi a SPI driver.
-         * @param gpio a GPIO driver.
-         * @param regAdress the MCP register address that needs to be written to.
-         * @param value the 1 byte data being written.
+         * Uses the default fixture wiring, primary expander CS pins 21 and 22.
          */
-        void secondaryWrite(SPIDriver& spi, GPIODriver& gpio, uint8_t regAdress, uint8_t value);
+        MCP23S17Controller() = default;
 
-         /**
-         * Reads a 1 byte message from a secondary expander with CS low.
-         * IMPORTANT - that only one secondary expander has CS low at a time.
-         * Otherwise incorrect data could be recieved.
-         * @param spi a SPI driver.
-         * @param gpio a GPIO driver.
-         * @param regAdress the MCP register address that needs to be read from.
-         * @return the 1 byte data read from the device.
+        /**
+         * Uses other primary expander CS pins, for fixtures not wired to the default pins.
+         * @param primary1Cs chip select of primary expander 1.
+         * @param primary2Cs chip select of primary expander 2.
          */
-        uint8_t secondaryRead(SPIDriver& spi, GPIODriver& gpio, uint8_t regAdress);
+        MCP23S17Controller(int primary1Cs, int primary2Cs);
 
-    public:
         /**
          * Struct containing the vital information regarding each pin on the DIO.
          * @param primaryExpander either 0 or 1 indicating one of the two primary expanders.
@@ -168,6 +127,13 @@ class MCP23S17Controller {
          */
         int initMCP23S17(SPIDriver& spi, GPIODriver& gpio);
 
+        /**
+         * Attaches the controller to the thread owning the bus. Its blocking methods called from
+         * other threads then run on that thread.
+         * @param owner the bus owner, or nullptr to access the bus from the calling thread.
+         */
+        void setBusOwner(BusOwner* owner);
+
         /**
          * Enables the provided DIO pin.
          * @param spi a SPI driver.
@@ -184,6 +150,19 @@ class MCP23S17Controller {
          */
         void disablePin(SPIDriver& spi, GPIODriver& gpio, DIOPinInfo DIOPin);
 
+        /**
+         * Enables and disables several pins on the same port of one secondary expander
+         * with a single read-modify-write, costing the same bus traffic as one enablePin.
+         * The protocol itself lives in MCP23S17Handle, see device_handle.hpp.
+         * @param spi a SPI driver.
+         * @param gpio a GPIO driver.
+         * @param DIOPin any pin on the port, selects the secondary expander and port A or B.
+         * @param setMask pins on the port to enable.
+         * @param clearMask pins on the port to disable.
+         * @returns -1 if a transfer failed.
+         */
+        int updatePort(SPIDriver& spi, GPIODriver& gpio, DIOPinInfo DIOPin, uint8_t setMask, uint8_t clearMask);
+
 };
 
 #endif
\ No newline at end of file
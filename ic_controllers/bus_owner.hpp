@@ -0,0 +1,33 @@
+/*
+ * bus_owner.hpp:
+ ***********************************************************************
+ * Interface of the thread that owns the SPI bus.
+ *      Controllers attached to a bus owner forward their blocking methods
+ *      to it when called from any other thread, so every caller goes
+ *      through the same queue as the bus thread's own work.
+ ***********************************************************************
+ */
+
+
+#include <functional>
+
+#ifndef BUSOWNER
+#define BUSOWNER
+
+class BusOwner {
+    public:
+        virtual ~BusOwner() = default;
+
+        /** @returns true if the calling thread may access the bus directly, it is the bus thread or no bus thread is running. */
+        virtual bool mayAccessBus() const = 0;
+
+        /**
+         * Runs work on the bus-owner thread and waits for it to finish.
+         * If no bus thread is running the work runs on the calling thread instead.
+         * @param work the bus access to run.
+         * @returns the value returned by work.
+         */
+        virtual int runOnBus(const std::function<int()>& work) = 0;
+};
+
+#endif
@@ -0,0 +1,156 @@
+/*
+ * calibration_table.cpp:
+ ***********************************************************************
+ * DAC and ADC calibration data.
+ *      Holds the measured transfer function of every AD8802 output and
+ *      the LTC2380 gain correction, as produced by the loopback
+ *      calibration in test_framework/calibrator. The file is
+ *      memory-mapped at startup and voltage to DAC input value
+ *      conversions become a single table read.
+ ***********************************************************************
+ */
+
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+
+#include "calibration_table.hpp"
+
+
+CalibrationTable::~CalibrationTable() {
+    unload();
+};
+
+int CalibrationTable::load(const std::string& path) {
+    unload();
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) < 0 || (size_t)info.st_size < sizeof(CalibrationHeader)) {
+        close(fd);
+        return -1;
+    }
+
+    void* mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        return -1;
+    }
+
+    const CalibrationHeader* mappedHeader = (const CalibrationHeader*)mapped;
+    size_t expectedSize = sizeof(CalibrationHeader) + CALIBRATION_DACS * CALIBRATION_OUTPUTS * sizeof(ChannelCalibration);
+    if (mappedHeader->magic != CALIBRATION_MAGIC || mappedHeader->version != CALIBRATION_VERSION
+            || mappedHeader->channelCount != CALIBRATION_DACS * CALIBRATION_OUTPUTS
+            || mappedHeader->voltageBins != CALIBRATION_VOLTAGE_BINS
+            || mappedHeader->maxVoltage <= 0 || expectedSize != (size_t)info.st_size) {
+        munmap(mapped, info.st_size);
+        return -1;
+    }
+
+    mapping = mapped;
+    mappingSize = info.st_size;
+    header = mappedHeader;
+    channels = (const ChannelCalibration*)(mappedHeader + 1);
+    binsPerVolt = (CALIBRATION_VOLTAGE_BINS - 1) / mappedHeader->maxVoltage;
+    return 0;
+};
+
+void CalibrationTable::unload() {
+    if (mapping != nullptr) {
+        munmap(mapping, mappingSize);
+    }
+    mapping = nullptr;
+    mappingSize = 0;
+    header = nullptr;
+    channels = nullptr;
+    binsPerVolt = 0;
+};
+
+bool CalibrationTable::loaded() const {
+    return header != nullptr;
+};
+
+const ChannelCalibration& CalibrationTable::channel(int dac, int dacOutput) const {
+    return channels[dac * CALIBRATION_OUTPUTS + dacOutput];
+};
+
+double CalibrationTable::adcVoltageGain() const {
+    return header->adcVoltageGain;
+};
+
+uint64_t CalibrationTable::created() const {
+    return header->created;
+};
+
+double CalibrationTable::fit(ChannelCalibration& channel, double maxVoltage) {
+    // Least squares fit of volts = gain*code + offset.
+    double sumX = 0, sumY = 0, sumXX = 0, sumXY = 0;
+    for (int code = 0; code < CALIBRATION_CODES; code++) {
+        sumX += code;
+        sumY += channel.measured[code];
+        sumXX += (double)code * code;
+        sumXY += code * (double)channel.measured[code];
+    }
+    double n = CALIBRATION_CODES;
+    channel.gain = (n*sumXY - sumX*sumY) / (n*sumXX - sumX*sumX);
+    channel.offset = (sumY - channel.gain*sumX) / n;
+
+    // Picks the input value with the closest measured voltage for every voltage bin.
+    for (int bin = 0; bin < CALIBRATION_VOLTAGE_BINS; bin++) {
+        double voltage = bin * maxVoltage / (CALIBRATION_VOLTAGE_BINS - 1);
+        int best = 0;
+        for (int code = 1; code < CALIBRATION_CODES; code++) {
+            if (std::fabs(channel.measured[code] - voltage) < std::fabs(channel.measured[best] - voltage)) {
+                best = code;
+            }
+        }
+        channel.codes[bin] = best;
+    }
+
+    double maxInl = 0;
+    for (int code = 0; code < CALIBRATION_CODES; code++) {
+        double inl = std::fabs(channel.measured[code] - (channel.gain*code + channel.offset));
+        maxInl = inl > maxInl ? inl : maxInl;
+    }
+    return maxInl;
+};
+
+int CalibrationTable::write(const std::string& path, double adcVoltageGain, const ChannelCalibration* channels,
+                            double maxVoltage, bool overwrite) {
+    // Like result logs, an existing calibration is only replaced when asked to.
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | (overwrite ? O_TRUNC : O_EXCL), 0644);
+    if (fd < 0) {
+        return -1;
+    }
+
+    CalibrationHeader header;
+    header.magic = CALIBRATION_MAGIC;
+    header.version = CALIBRATION_VERSION;
+    header.channelCount = CALIBRATION_DACS * CALIBRATION_OUTPUTS;
+    header.voltageBins = CALIBRATION_VOLTAGE_BINS;
+    header.maxVoltage = maxVoltage;
+    header.adcVoltageGain = adcVoltageGain;
+    // Nanoseconds, so two calibrations run within the same second still get different ids.
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    header.created = (uint64_t)now.tv_sec * 1000000000ull + now.tv_nsec;
+
+    FILE* out = fdopen(fd, "wb");
+    if (out == nullptr) {
+        close(fd);
+        return -1;
+    }
+    fwrite(&header, sizeof(header), 1, out);
+    fwrite(channels, sizeof(ChannelCalibration), CALIBRATION_DACS * CALIBRATION_OUTPUTS, out);
+    bool written = ferror(out) == 0;
+    return fclose(out) == 0 && written ? 0 : -1;
+};
@@ -0,0 +1,144 @@
+/*
+ * calibration_table.hpp:
+ ***********************************************************************
+ * DAC and ADC calibration data.
+ *      Holds the measured transfer function of every AD8802 output and
+ *      the LTC2380 gain correction, as produced by the loopback
+ *      calibration in test_framework/calibrator. The file is
+ *      memory-mapped at startup and voltage to DAC input value
+ *      conversions become a single table read.
+ ***********************************************************************
+ */
+
+
+#include <cstdint>
+#include <string>
+
+#ifndef CALIBRATIONTABLE
+#define CALIBRATIONTABLE
+
+/** Identifies a calibration file, "ICCL". */
+#define CALIBRATION_MAGIC 0x4C434349
+#define CALIBRATION_VERSION 1
+
+/** Sizes of the calibration tables. */
+#define CALIBRATION_DACS 2
+#define CALIBRATION_OUTPUTS 12
+#define CALIBRATION_CODES 256
+#define CALIBRATION_VOLTAGE_BINS 1024
+
+/**
+ * Header at the start of every calibration file.
+ * @param magic always CALIBRATION_MAGIC.
+ * @param version format version, CALIBRATION_VERSION.
+ * @param channelCount number of ChannelCalibration entries following the header.
+ * @param voltageBins number of entries in each voltage to code lookup.
+ * @param maxVoltage voltage covered by the last lookup bin.
+ * @param adcVoltageGain LTC2380 voltage gain correction, replaces the hand-tuned error offset.
+ * @param created CLOCK_REALTIME time the calibration was run in nanoseconds, identifies the calibration.
+ */
+struct CalibrationHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t channelCount;
+    uint32_t voltageBins;
+    double maxVoltage;
+    double adcVoltageGain;
+    uint64_t created;
+};
+
+/**
+ * Calibration of a single DAC output.
+ * @param gain fitted volts per DAC input value.
+ * @param offset fitted volts at DAC input value 0.
+ * @param measured measured voltage at every DAC input value, the difference to the fit is the INL.
+ * @param codes DAC input value to use for each voltage bin.
+ */
+struct ChannelCalibration {
+    double gain;
+    double offset;
+    float measured[CALIBRATION_CODES];
+    uint8_t codes[CALIBRATION_VOLTAGE_BINS];
+};
+
+class CalibrationTable {
+    private:
+        /** The mapped file, header followed by the channels. */
+        void* mapping = nullptr;
+        size_t mappingSize = 0;
+
+        const CalibrationHeader* header = nullptr;
+        const ChannelCalibration* channels = nullptr;
+
+        /** Bins per volt, precomputed so a lookup is a multiply and a read. */
+        double binsPerVolt = 0;
+
+    public:
+        CalibrationTable() = default;
+        ~CalibrationTable();
+
+        CalibrationTable(const CalibrationTable&) = delete;
+        CalibrationTable& operator=(const CalibrationTable&) = delete;
+
+        /**
+         * Memory-maps a calibration file and validates its header.
+         * @param path the calibration file.
+         * @returns -1 if the file could not be mapped or is not a valid calibration file.
+         */
+        int load(const std::string& path);
+
+        /** Unmaps the calibration, if one is loaded. */
+        void unload();
+
+        /** @returns true if a calibration is loaded. */
+        bool loaded() const;
+
+        /**
+         * Gets the DAC input value which produces the closest measured voltage.
+         * @param dac the DAC, 0 or 1.
+         * @param dacOutput the DAC output channel, 0-11.
+         * @param voltage the desired voltage.
+         * @returns the DAC input value, 0-255.
+         */
+        inline uint8_t code(int dac, int dacOutput, double voltage) const {
+            int bin = (int)(voltage * binsPerVolt + 0.5);
+            bin = bin < 0 ? 0 : bin;
+            bin = bin >= CALIBRATION_VOLTAGE_BINS ? CALIBRATION_VOLTAGE_BINS - 1 : bin;
+            return channels[dac * CALIBRATION_OUTPUTS + dacOutput].codes[bin];
+        }
+
+        /**
+         * @param dac the DAC, 0 or 1.
+         * @param dacOutput the DAC output channel, 0-11.
+         * @returns the calibration of a single DAC output.
+         */
+        const ChannelCalibration& channel(int dac, int dacOutput) const;
+
+        /** @returns the LTC2380 voltage gain correction. */
+        double adcVoltageGain() const;
+
+        /** @returns the CLOCK_REALTIME time the calibration was run in nanoseconds, identifies the calibration. */
+        uint64_t created() const;
+
+        /**
+         * Fits a swept DAC output, the least squares gain and offset and the closest input value for every voltage bin.
+         * @param channel a channel with every measured voltage set, gain, offset and codes are filled in.
+         * @param maxVoltage voltage covered by the last lookup bin.
+         * @returns the largest difference between a measured voltage and the fit, the INL.
+         */
+        static double fit(ChannelCalibration& channel, double maxVoltage);
+
+        /**
+         * Writes a calibration file.
+         * @param path the output file.
+         * @param adcVoltageGain the LTC2380 voltage gain correction.
+         * @param channels CALIBRATION_DACS * CALIBRATION_OUTPUTS channels, DAC 0 outputs first.
+         * @param maxVoltage voltage covered by the last lookup bin.
+         * @param overwrite replace an existing file, otherwise an existing file is left alone.
+         * @returns -1 if the file exists and overwrite is false (errno is then EEXIST), or could not be written.
+         */
+        static int write(const std::string& path, double adcVoltageGain, const ChannelCalibration* channels,
+                         double maxVoltage, bool overwrite = false);
+};
+
+#endif
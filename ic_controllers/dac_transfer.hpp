@@ -0,0 +1,32 @@
+/*
+ * dac_transfer.hpp:
+ ***********************************************************************
+ * Ideal AD8802 transfer function.
+ *      Header only and free of any hardware dependency, so the plan
+ *      compiler converts DAC voltages the same way the controllers do
+ *      without linking the drivers.
+ ***********************************************************************
+ */
+
+
+#include <cstdint>
+#include <cmath>
+
+#ifndef DACTRANSFER
+#define DACTRANSFER
+
+/** Max voltage output of the AD8802. */
+constexpr double AD8802_MAX_VOLTAGE = 5.0; // IMPORTANT VALUE, ENSURE CORRECTNESS
+
+/**
+ * Calculates the value that needs to be sent to the DAC for a desired voltage, assuming the ideal transfer function.
+ * @param voltage the desired voltage output from the DAC.
+ * @returns the closest of the 256 input values, clamped to 0-255.
+ */
+inline uint8_t idealDacCode(double voltage) {
+    // The DAC divides its input value by 256 to get the output voltage.
+    long code = std::lround(voltage / AD8802_MAX_VOLTAGE * 256);
+    return (uint8_t)(code < 0 ? 0 : code > 255 ? 255 : code);
+}
+
+#endif
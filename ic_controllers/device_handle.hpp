@@ -0,0 +1,607 @@
+/*
+ * device_handle.hpp:
+ ***********************************************************************
+ * Device handles, the one implementation of the board protocols.
+ *      A handle binds one board controller to its bus. The backend, the
+ *      chip selects and the timing profile are template parameters, so
+ *      with pins fixed at compile time the whole select/transfer/deselect
+ *      path inlines, and a chip select wired to the wrong kind of chip or
+ *      to a pin of the backend's own SPI bus does not compile.
+ *
+ *      Chip selects carry the kind of chip they are wired to:
+ *          AD8802Handle<WiringPiBackend<0, 0>, DacCs<23>> dac{backend};      compiles
+ *          AD8802Handle<WiringPiBackend<0, 0>, ExpanderCs<21>> dac{backend}; does not
+ *          AD8802Handle<WiringPiBackend<1, 0>, DacCs<24>> dac{backend};      does not, 24 is SPI1 MISO
+ *
+ *      The default fixture is driven through these handles as
+ *      HandleBus<WiringPiBackend<0, 0>> with DefaultWiring, see
+ *      fixture_bus.hpp. The runtime controllers (MCP23S17Controller,
+ *      AD8802Controller, LTC2380Controller) run their bus access through
+ *      them with DriverBackend and RuntimeCs, for fixtures whose wiring is
+ *      only known at runtime, e.g. FixtureConfig. Their pins are checked
+ *      at runtime by FixtureScheduler::validate instead.
+ *      tests/compile_fail holds the wirings that must not compile.
+ ***********************************************************************
+ */
+
+
+#include <wiringPi.h>
+#include <wiringPiSPI.h>
+#include <cstdint>
+#include <cmath>
+
+#include "MCP23S17.hpp"
+#include "AD8802.hpp"
+#include "../hardware_drivers/spi.hpp"
+#include "../hardware_drivers/gpio.hpp"
+#include "../diagnostics/tracer.hpp"
+
+#ifndef DEVICEHANDLE
+#define DEVICEHANDLE
+
+/** Kinds of chip a chip select can be wired to. */
+typedef enum {
+    CS_EXPANDER,
+    CS_DAC,
+    CS_ADC
+} ChipSelectRole;
+
+/**
+ * @param bus a SPI bus number, -1 if it is only known at runtime.
+ * @param pin a wiringPi pin number, -1 if it is only known at runtime.
+ * @returns true if the bus takes the pin over, see SPIDriver::BUS_PINS.
+ */
+constexpr bool spiBusPin(int bus, int pin) {
+    if (bus < 0 || bus > SPIDriver::MAX_BUS || pin < 0) {
+        return false;
+    }
+    for (int busPin : SPIDriver::BUS_PINS[bus]) {
+        if (busPin == pin) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * A chip select pin fixed at compile time and the kind of chip it is wired to.
+ * Whether the pin is free depends on the bus, the handles check it against their backend's bus.
+ * @param Role one of ChipSelectRole.
+ * @param Pin the wiringPi pin number.
+ */
+template <ChipSelectRole Role, int Pin>
+struct ChipSelect {
+    static_assert(Pin >= 0 && Pin <= 31, "Chip selects must be wiringPi pins 0-31.");
+
+    static constexpr ChipSelectRole ROLE = Role;
+    static constexpr int PIN = Pin;
+
+    constexpr int pin() const {
+        return Pin;
+    }
+};
+
+/**
+ * A chip select pin only known at runtime, used by the runtime controllers.
+ * @param Role one of ChipSelectRole.
+ */
+template <ChipSelectRole Role>
+struct RuntimeCs {
+    static constexpr ChipSelectRole ROLE = Role;
+    /** Not known at compile time, so the compile time checks skip it. */
+    static constexpr int PIN = -1;
+
+    int number = -1;
+
+    int pin() const {
+        return number;
+    }
+};
+
+/** Chip select of a primary MCP23S17 expander. */
+template <int Pin>
+using ExpanderCs = ChipSelect<CS_EXPANDER, Pin>;
+
+/** Chip select of an AD8802 DAC. */
+template <int Pin>
+using DacCs = ChipSelect<CS_DAC, Pin>;
+
+/** SDI pin of an LTC2380 ADC, used as its chip select. */
+template <int Pin>
+using AdcCs = ChipSelect<CS_ADC, Pin>;
+
+/**
+ * Wiring of a whole fixture, checked for shared pins at compile time.
+ * @param Expander1 chip select of primary expander 1.
+ * @param Expander2 chip select of primary expander 2.
+ * @param Dac1 chip select of DAC 1.
+ * @param Dac2 chip select of DAC 2.
+ * @param Adc the SDI pin of the ADC used as a CS.
+ * @param Cnv the conversion start pin of the ADC.
+ */
+template <int Expander1, int Expander2, int Dac1, int Dac2, int Adc, int Cnv>
+struct FixtureWiring {
+    static_assert(Expander1 != Expander2 && Expander1 != Dac1 && Expander1 != Dac2 && Expander1 != Adc && Expander1 != Cnv
+                  && Expander2 != Dac1 && Expander2 != Dac2 && Expander2 != Adc && Expander2 != Cnv
+                  && Dac1 != Dac2 && Dac1 != Adc && Dac1 != Cnv
+                  && Dac2 != Adc && Dac2 != Cnv
+                  && Adc != Cnv, "Every chip select and the CNV pin need their own pin.");
+
+    typedef ExpanderCs<Expander1> Expander1Cs;
+    typedef ExpanderCs<Expander2> Expander2Cs;
+    typedef DacCs<Dac1> Dac1Cs;
+    typedef DacCs<Dac2> Dac2Cs;
+    typedef AdcCs<Adc> AdcSdi;
+    static constexpr int ADC_CNV = Cnv;
+};
+
+/**
+ * The original single fixture wiring, the same pins the controllers default to.
+ * Only valid on SPI0, 24 and 29 are SPI1 MISO and SCLK, so a bus 1 backend does not compile with it.
+ */
+typedef FixtureWiring<21, 22, 23, 24, 25, 29> DefaultWiring;
+
+/**
+ * Timing used by the controllers. Boards verified with shorter delays can
+ * define their own profile with the same members.
+ * @param EXPANDER_CS_DELAY_US wait on both sides of every primary expander transfer, 0 to not wait.
+ * @param ADC_CNV_PULSE_NS length of the LTC2380 CNV pulse.
+ */
+struct StandardTiming {
+    static constexpr int EXPANDER_CS_DELAY_US = 100;
+    static constexpr int ADC_CNV_PULSE_NS = 30;
+};
+
+/**
+ * Estimated nanosecond delay, each nop takes ~1 cycle at the RPi5's 2.4 GHz, so 2.4 nops are 1 ns.
+ * @param howLong the delay in nanoseconds.
+ */
+inline void spinNanoseconds(int howLong) {
+    for (int i = 0; i < howLong * 12 / 5; i++) {
+        asm volatile("nop");
+    }
+}
+
+/**
+ * Traces the window each chip select is held low as a "cs" event.
+ * Remembers which pins had their begin recorded, so a deselect only ends an event that was begun.
+ */
+class CsTrace {
+    private:
+        uint32_t traced = 0;
+
+    public:
+        inline void begin(int pin) {
+            if (pin >= 0 && pin < 32 && Tracer::enabled() && Tracer::begin("cs", pin)) {
+                traced |= 1u << pin;
+            }
+        }
+
+        inline void end(int pin) {
+            if (pin >= 0 && pin < 32 && (traced & (1u << pin))) {
+                traced &= ~(1u << pin);
+                Tracer::end("cs");
+            }
+        }
+};
+
+/**
+ * Backend going through SPIDriver and GPIODriver, so the bus can be chosen at runtime and
+ * transfers and delays still show up in traces. Used by the runtime controllers.
+ */
+class DriverBackend {
+    private:
+        SPIDriver& spi;
+        GPIODriver& gpio;
+        CsTrace csTrace;
+
+    public:
+        /** The bus is only known at runtime, pins are checked by FixtureScheduler::validate. */
+        static constexpr int BUS = -1;
+
+        /**
+         * @param spi the SPI driver of the bus.
+         * @param gpio a GPIO driver.
+         */
+        DriverBackend(SPIDriver& spi, GPIODriver& gpio) : spi(spi), gpio(gpio) {
+        }
+
+        inline int transfer(uint8_t* data, int len) {
+            return spi.readWrite(data, len);
+        }
+
+        inline void low(int pin) {
+            gpio.low(pin);
+        }
+
+        inline void high(int pin) {
+            gpio.high(pin);
+        }
+
+        /** Pulls a chip select low, traced until the matching deselect. */
+        inline void select(int pin) {
+            csTrace.begin(pin);
+            gpio.low(pin);
+        }
+
+        inline void deselect(int pin) {
+            gpio.high(pin);
+            csTrace.end(pin);
+        }
+
+        inline void delayUs(int howLong) {
+            TRACE_SCOPE("delayMicroseconds", howLong);
+            delayMicroseconds(howLong);
+        }
+
+        inline void delayNs(int howLong) {
+            TRACE_SCOPE("delayNanoseconds", howLong);
+            spinNanoseconds(howLong);
+        }
+};
+
+/**
+ * Backend calling wiringPi directly on a bus fixed at compile time, every
+ * operation inlines down to the wiringPi calls and a trace point, which costs
+ * one relaxed load while tracing is off. The bus must be set up by an SPIDriver first.
+ * @param Bus the SPI bus number, the x in /dev/spidevx.y.
+ * @param Channel the SPI channel on the bus, the y in /dev/spidevx.y.
+ */
+template <int Bus, int Channel>
+class WiringPiBackend {
+    static_assert(Bus >= 0 && Bus <= SPIDriver::MAX_BUS, "The RPi has SPI buses 0-6.");
+    static_assert(Channel >= 0 && Channel <= 2, "SPI channels are 0-2.");
+
+    private:
+        CsTrace csTrace;
+
+    public:
+        /** Chip selects of handles on this backend may not be pins of this bus. */
+        static constexpr int BUS = Bus;
+
+        inline int transfer(uint8_t* data, int len) {
+            TRACE_SCOPE("spi.readWrite", len);
+            return wiringPiSPIxDataRW(Bus, Channel, data, len);
+        }
+
+        inline void low(int pin) {
+            digitalWrite(pin, LOW);
+        }
+
+        inline void high(int pin) {
+            digitalWrite(pin, HIGH);
+        }
+
+        /** Pulls a chip select low, traced until the matching deselect. */
+        inline void select(int pin) {
+            csTrace.begin(pin);
+            digitalWrite(pin, LOW);
+        }
+
+        inline void deselect(int pin) {
+            digitalWrite(pin, HIGH);
+            csTrace.end(pin);
+        }
+
+        inline void delayUs(int howLong) {
+            TRACE_SCOPE("delayMicroseconds", howLong);
+            delayMicroseconds(howLong);
+        }
+
+        inline void delayNs(int howLong) {
+            TRACE_SCOPE("delayNanoseconds", howLong);
+            spinNanoseconds(howLong);
+        }
+};
+
+/**
+ * A DIO pin fixed at compile time, see MCP23S17Controller::DIOPinInfo.
+ * @param PrimaryExpander either 0 or 1.
+ * @param PrimaryPin the pin with the CS of the secondary expander, 0-15.
+ * @param SecondaryExpander in the range of 2-33.
+ * @param SecondaryPin the pin on the secondary expander, 0-15.
+ */
+template <int PrimaryExpander, int PrimaryPin, int SecondaryExpander, int SecondaryPin>
+struct DioPin {
+    static_assert(PrimaryExpander == 0 || PrimaryExpander == 1, "There are 2 primary expanders, 0 and 1.");
+    static_assert(PrimaryPin >= 0 && PrimaryPin <= 15, "Primary expander pins are 0-15.");
+    static_assert(SecondaryExpander >= 2 && SecondaryExpander <= 33, "Secondary expanders are 2-33.");
+    static_assert(SecondaryPin >= 0 && SecondaryPin <= 15, "Secondary expander pins are 0-15.");
+
+    static constexpr MCP23S17Controller::DIOPinInfo INFO = {PrimaryExpander, PrimaryPin, SecondaryExpander, SecondaryPin};
+};
+
+/**
+ * MCP23S17 DIO boards bound to their bus.
+ * @param Backend DriverBackend or WiringPiBackend.
+ * @param Expander1 ExpanderCs of primary expander 1, RuntimeCs<CS_EXPANDER> if only known at runtime.
+ * @param Expander2 ExpanderCs of primary expander 2, RuntimeCs<CS_EXPANDER> if only known at runtime.
+ * @param Timing the timing profile.
+ */
+template <typename Backend, typename Expander1, typename Expander2, typename Timing = StandardTiming>
+class MCP23S17Handle {
+    static_assert(Expander1::ROLE == CS_EXPANDER && Expander2::ROLE == CS_EXPANDER,
+                  "MCP23S17Handle needs primary expander chip selects, use ExpanderCs<pin>.");
+    static_assert(Expander1::PIN == -1 || Expander1::PIN != Expander2::PIN,
+                  "The primary expanders need their own chip selects.");
+    static_assert(!spiBusPin(Backend::BUS, Expander1::PIN) && !spiBusPin(Backend::BUS, Expander2::PIN),
+                  "A primary expander chip select is a pin of the backend's SPI bus.");
+
+    private:
+        Backend backend;
+        Expander1 expander1;
+        Expander2 expander2;
+
+        static constexpr uint8_t PRIMARY_WRITE_OPCODE = 0x42;
+        static constexpr uint8_t SECONDARY_WRITE_OPCODE = 0x40;
+        static constexpr uint8_t SECONDARY_READ_OPCODE = 0x41;
+
+        inline void csDelay() {
+            if (Timing::EXPANDER_CS_DELAY_US > 0) {
+                backend.delayUs(Timing::EXPANDER_CS_DELAY_US);
+            }
+        }
+
+        /**
+         * Writes a register of one primary expander, or of both at once.
+         * @returns -1 if the transfer failed, the chip selects are released either way.
+         */
+        inline int primaryWrite(int cs1, int cs2, uint8_t regAddress, uint8_t value) {
+            uint8_t data[3] = {PRIMARY_WRITE_OPCODE, regAddress, value};
+            backend.select(cs1);
+            if (cs2 != -1) {
+                backend.select(cs2);
+            }
+            csDelay();
+            int result = backend.transfer(data, 3);
+            csDelay();
+            // Released in reverse, so the traced windows nest.
+            if (cs2 != -1) {
+                backend.deselect(cs2);
+            }
+            backend.deselect(cs1);
+            return result == -1 ? -1 : 0;
+        }
+
+        /** Selects or deselects a secondary expander through the primary expander it hangs off. */
+        inline int primaryWrite(int primaryExpander, uint8_t regAddress, uint8_t value) {
+            return primaryWrite(primaryExpander == 0 ? expander1.pin() : expander2.pin(), -1, regAddress, value);
+        }
+
+        /** Writes a register of every secondary expander whose CS is low. */
+        inline int secondaryWrite(uint8_t regAddress, uint8_t value) {
+            uint8_t data[3] = {SECONDARY_WRITE_OPCODE, regAddress, value};
+            return backend.transfer(data, 3) == -1 ? -1 : 0;
+        }
+
+    public:
+        /**
+         * @param backend the backend of the bus.
+         * @param expander1 chip select of primary expander 1, only needed for RuntimeCs.
+         * @param expander2 chip select of primary expander 2, only needed for RuntimeCs.
+         */
+        explicit MCP23S17Handle(Backend backend, Expander1 expander1 = Expander1(), Expander2 expander2 = Expander2())
+            : backend(backend), expander1(expander1), expander2(expander2) {
+        }
+
+        /**
+         * Brings the board into its ready state, see MCP23S17Controller::initMCP23S17.
+         * Turns on IOCON.HAEN, makes every expander pin an output and deselects every secondary expander.
+         * @returns -1 if a transfer failed.
+         */
+        inline int init() {
+            int result = 0;
+            int cs1 = expander1.pin();
+            int cs2 = expander2.pin();
+
+            // Enables the IOCON.HAEN bit which enables hardware addressing.
+            //   All expanders are addressed here since there is no distinction between primaries and secondaries
+            //   before HAEN is turned on. Secondaries have CS low by default, this init handles that.
+            result |= primaryWrite(cs1, cs2, IOCON, 0x08);
+
+            // Sets the I/O direction of the primary expanders to output.
+            result |= primaryWrite(cs1, cs2, IODIRA, 0x00);
+            result |= primaryWrite(cs1, cs2, IODIRB, 0x00);
+
+            result |= primaryWrite(cs1, cs2, OLATA, 0xFF);
+            result |= primaryWrite(cs1, cs2, OLATB, 0xFF);
+
+            // Sets the I/O direction of the secondary expanders to output.
+            result |= primaryWrite(cs1, cs2, OLATA, 0x00);
+            result |= primaryWrite(cs1, cs2, OLATB, 0x00);
+            result |= secondaryWrite(IODIRA, 0x00);
+            result |= primaryWrite(cs1, cs2, OLATA, 0xFF);
+            result |= primaryWrite(cs1, cs2, OLATB, 0xFF);
+
+            result |= primaryWrite(cs1, cs2, OLATA, 0x00);
+            result |= primaryWrite(cs1, cs2, OLATB, 0x00);
+            result |= secondaryWrite(IODIRB, 0xFF);
+            result |= primaryWrite(cs1, cs2, OLATA, 0xFF);
+            result |= primaryWrite(cs1, cs2, OLATB, 0xFF);
+
+            return result == 0 ? 0 : -1;
+        }
+
+        /**
+         * Enables and disables several pins on the same port of one secondary expander
+         * with a single read-modify-write, costing the same bus traffic as one enablePin.
+         * @param pin any pin on the port, selects the secondary expander and port A or B.
+         * @param setMask pins on the port to enable.
+         * @param clearMask pins on the port to disable.
+         * @returns -1 if a transfer failed, the port is not written if its state could not be read.
+         */
+        inline int updatePort(MCP23S17Controller::DIOPinInfo pin, uint8_t setMask, uint8_t clearMask) {
+            uint8_t primaryRegAddress = pin.primaryPin < 8 ? OLATA : OLATB;
+            uint8_t primaryValue = ~(0b00000001 << (pin.primaryPin % 8));
+            uint8_t secondaryRegAddress = pin.secondaryPin < 8 ? OLATA : OLATB;
+
+            // Reads current state of secondary, so other pins are maintained.
+            int result = primaryWrite(pin.primaryExpander, primaryRegAddress, primaryValue);
+            uint8_t read[3] = {SECONDARY_READ_OPCODE, secondaryRegAddress, 0x00};
+            int readResult = backend.transfer(read, 3);
+            result |= primaryWrite(pin.primaryExpander, primaryRegAddress, 0xFF);
+            if (readResult == -1 || result == -1) {
+                return -1;
+            }
+
+            // Turns the selected pins on and off.
+            result |= primaryWrite(pin.primaryExpander, primaryRegAddress, primaryValue);
+            result |= secondaryWrite(secondaryRegAddress, (uint8_t)((read[2] | setMask) & ~clearMask));
+            result |= primaryWrite(pin.primaryExpander, primaryRegAddress, 0xFF);
+            return result == 0 ? 0 : -1;
+        }
+
+        inline int enablePin(MCP23S17Controller::DIOPinInfo pin) {
+            return updatePort(pin, 0b00000001 << (pin.secondaryPin % 8), 0x00);
+        }
+
+        inline int disablePin(MCP23S17Controller::DIOPinInfo pin) {
+            return updatePort(pin, 0x00, 0b00000001 << (pin.secondaryPin % 8));
+        }
+
+        /** Enables a DIO pin fixed at compile time, use DioPin<...>. */
+        template <typename Pin>
+        inline int enablePin() {
+            return enablePin(Pin::INFO);
+        }
+
+        /** Disables a DIO pin fixed at compile time, use DioPin<...>. */
+        template <typename Pin>
+        inline int disablePin() {
+            return disablePin(Pin::INFO);
+        }
+};
+
+/**
+ * A single AD8802 DAC bound to its bus.
+ * @param Backend DriverBackend or WiringPiBackend.
+ * @param Cs DacCs of the DAC, RuntimeCs<CS_DAC> if only known at runtime.
+ * @param Timing the timing profile.
+ */
+template <typename Backend, typename Cs, typename Timing = StandardTiming>
+class AD8802Handle {
+    static_assert(Cs::ROLE == CS_DAC, "AD8802Handle needs a DAC chip select, use DacCs<pin>.");
+    static_assert(!spiBusPin(Backend::BUS, Cs::PIN), "The DAC chip select is a pin of the backend's SPI bus.");
+
+    private:
+        Backend backend;
+        Cs cs;
+
+    public:
+        /**
+         * @param backend the backend of the bus.
+         * @param cs chip select of the DAC, only needed for RuntimeCs.
+         */
+        explicit AD8802Handle(Backend backend, Cs cs = Cs()) : backend(backend), cs(cs) {
+        }
+
+        /**
+         * Applies a DAC input value to a DAC output.
+         * @param dacOutput the DAC output channel, 0-11.
+         * @param code the DAC input value, 0-255.
+         * @returns -1 if the transfer failed.
+         */
+        inline int applyCode(int dacOutput, uint8_t code) {
+            // 4 address bits, then the 8 value bits. Output n has address n.
+            uint8_t data[2] = {(uint8_t)(dacOutput & 0x0F), code};
+            backend.select(cs.pin());
+            int result = backend.transfer(data, 2);
+            backend.deselect(cs.pin());
+            return result == -1 ? -1 : 0;
+        }
+
+        /** Applies a DAC input value to a DAC output fixed at compile time. */
+        template <int DacOutput>
+        inline int applyCode(uint8_t code) {
+            static_assert(DacOutput >= 0 && DacOutput <= 11, "The AD8802 has outputs 0-11.");
+            return applyCode(DacOutput, code);
+        }
+
+        /**
+         * Applies a voltage to a DAC output with the ideal transfer function,
+         * use CalibrationTable::code with applyCode for calibrated outputs.
+         * @param dacOutput the DAC output channel, 0-11.
+         * @param voltage the desired voltage, 0-5V.
+         * @returns -1 if the transfer failed.
+         */
+        inline int applyVoltage(int dacOutput, double voltage) {
+            return applyCode(dacOutput, idealDacCode(voltage));
+        }
+};
+
+/**
+ * The LTC2380 ADC bound to its bus.
+ * Scaling stays in LTC2380Controller::scale, it carries the calibration.
+ * @param Backend DriverBackend or WiringPiBackend.
+ * @param Cs AdcCs of the ADC, RuntimeCs<CS_ADC> if only known at runtime.
+ * @param Cnv the conversion start pin, -1 if only known at runtime.
+ * @param Timing the timing profile.
+ */
+template <typename Backend, typename Cs, int Cnv, typename Timing = StandardTiming>
+class LTC2380Handle {
+    static_assert(Cs::ROLE == CS_ADC, "LTC2380Handle needs an ADC chip select, use AdcCs<pin>.");
+    static_assert(Cnv == -1 || Cnv != Cs::PIN, "CNV and the ADC chip select need their own pins.");
+    static_assert(!spiBusPin(Backend::BUS, Cs::PIN) && !spiBusPin(Backend::BUS, Cnv),
+                  "The ADC chip select or CNV pin is a pin of the backend's SPI bus.");
+
+    private:
+        Backend backend;
+        Cs cs;
+        int cnv;
+
+    public:
+        /**
+         * @param backend the backend of the bus.
+         * @param cs the ADC's SDI pin, only needed for RuntimeCs.
+         * @param cnv the conversion start pin, only needed if Cnv is -1.
+         */
+        explicit LTC2380Handle(Backend backend, Cs cs = Cs(), int cnv = Cnv) : backend(backend), cs(cs), cnv(cnv) {
+        }
+
+        /**
+         * Starts a conversion and reads the result.
+         * @param raw set to the signed 24-bit conversion result.
+         * @returns -1 if the transfer failed, raw is then unchanged.
+         */
+        inline int readRaw(int& raw) {
+            // Trigger conversion and ensure the trigger is on for adequate time.
+            backend.high(cnv);
+            backend.delayNs(Timing::ADC_CNV_PULSE_NS);
+            backend.low(cnv);
+
+            // Enable SDO and read the output from ADC.
+            //    First 24 bits are the result, the last 16 are the number of samples averaged.
+            //    Might have to tie the SPI read to wait on the BUSY pin on the ADC going low, otherwise it may be misaligned.
+            uint8_t data[5];
+            backend.select(cs.pin());
+            int result = backend.transfer(data, 5);
+            backend.deselect(cs.pin());
+            if (result == -1) {
+                return -1;
+            }
+
+            // Sign extends the 24-bit two's complement result.
+            int value = data[0] << 24 | data[1] << 16 | data[2] << 8;
+            raw = value >> 8;
+            return 0;
+        }
+};
+
+/**
+ * Every device of a fixture bound to one backend.
+ * @param Backend WiringPiBackend, DriverBackend fixtures use the runtime controllers.
+ * @param Wiring a FixtureWiring, DefaultWiring for the original fixture on SPI0.
+ * @param Timing the timing profile.
+ */
+template <typename Backend, typename Wiring = DefaultWiring, typename Timing = StandardTiming>
+struct FixtureHandles {
+    MCP23S17Handle<Backend, typename Wiring::Expander1Cs, typename Wiring::Expander2Cs, Timing> MCP23S17;
+    AD8802Handle<Backend, typename Wiring::Dac1Cs, Timing> DAC1;
+    AD8802Handle<Backend, typename Wiring::Dac2Cs, Timing> DAC2;
+    LTC2380Handle<Backend, typename Wiring::AdcSdi, Wiring::ADC_CNV, Timing> LTC2380;
+
+    explicit FixtureHandles(Backend backend) : MCP23S17(backend), DAC1(backend), DAC2(backend), LTC2380(backend) {
+    }
+};
+
+#endif
@@ -0,0 +1,120 @@
+/*
+ * fixture_bus.cpp:
+ ***********************************************************************
+ * Bus access to the boards of one fixture.
+ *      The forwarding to the bus owner shared by every fixture bus, and
+ *      ControllerBus, which drives fixtures wired at runtime through the
+ *      runtime controllers.
+ ***********************************************************************
+ */
+
+
+#include <wiringPi.h>
+#include <ctime>
+
+#include "fixture_bus.hpp"
+#include "../diagnostics/tracer.hpp"
+
+
+/** @returns CLOCK_MONOTONIC time in nanoseconds, the clock result logs use. */
+static uint64_t monotonicNs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+void FixtureBus::setBusOwner(BusOwner* owner) {
+    busOwner = owner;
+};
+
+int FixtureBus::updatePort(MCP23S17Controller::DIOPinInfo pin, uint8_t setMask, uint8_t clearMask) {
+    if (busOwner != nullptr && !busOwner->mayAccessBus()) {
+        return busOwner->runOnBus([&]() { return updatePortDirect(pin, setMask, clearMask); });
+    }
+    return updatePortDirect(pin, setMask, clearMask);
+};
+
+int FixtureBus::enablePin(MCP23S17Controller::DIOPinInfo pin) {
+    return updatePort(pin, 0b00000001 << (pin.secondaryPin % 8), 0x00);
+};
+
+int FixtureBus::disablePin(MCP23S17Controller::DIOPinInfo pin) {
+    return updatePort(pin, 0x00, 0b00000001 << (pin.secondaryPin % 8));
+};
+
+int FixtureBus::applyCode(int dac, int dacOutput, uint8_t code) {
+    if (busOwner != nullptr && !busOwner->mayAccessBus()) {
+        return busOwner->runOnBus([&]() { return applyCodeDirect(dac, dacOutput, code); });
+    }
+    return applyCodeDirect(dac, dacOutput, code);
+};
+
+int FixtureBus::readRaw(int& raw) {
+    if (busOwner != nullptr && !busOwner->mayAccessBus()) {
+        return busOwner->runOnBus([&]() { return readRawDirect(raw); });
+    }
+    return readRawDirect(raw);
+};
+
+BusResult FixtureBus::execute(const BusOperation& op) {
+    BusResult result = {0, false, monotonicNs(), 0};
+    switch (op.type) {
+        case BUS_DIO_PORT:
+            result.failed = updatePort(op.pin, op.setMask, op.clearMask) == -1;
+            break;
+        case BUS_DAC_CODE:
+            result.failed = applyCode(op.dac, op.dacOutput, op.code) == -1;
+            break;
+        case BUS_ADC_RAW: {
+            int raw;
+            result.failed = readRaw(raw) == -1;
+            result.value = result.failed ? 0 : raw;
+            break;
+        }
+        case BUS_WAIT: {
+            TRACE_SCOPE("delayMicroseconds", op.waitUs);
+            delayMicroseconds(op.waitUs);
+            break;
+        }
+    }
+    result.finished = monotonicNs();
+    return result;
+};
+
+ControllerBus::ControllerBus(SPIDriver& spi, GPIODriver& gpio, MCP23S17Controller& mcp, AD8802Controller& dac, LTC2380Controller& adc)
+    : spi(spi), gpio(gpio), MCP23S17(mcp), AD8802(dac), LTC2380(adc) {
+};
+
+void ControllerBus::setBusOwner(BusOwner* owner) {
+    FixtureBus::setBusOwner(owner);
+    MCP23S17.setBusOwner(owner);
+    AD8802.setBusOwner(owner);
+    LTC2380.setBusOwner(owner);
+};
+
+int ControllerBus::initMCP23S17() {
+    return MCP23S17.initMCP23S17(spi, gpio);
+};
+
+int ControllerBus::initAD8802() {
+    return AD8802.initAD8802(spi, gpio);
+};
+
+int ControllerBus::initLTC2380() {
+    return LTC2380.initLTC2380(spi, gpio);
+};
+
+int ControllerBus::updatePortDirect(MCP23S17Controller::DIOPinInfo pin, uint8_t setMask, uint8_t clearMask) {
+    return MCP23S17.updatePort(spi, gpio, pin, setMask, clearMask);
+};
+
+int ControllerBus::applyCodeDirect(int dac, int dacOutput, uint8_t code) {
+    if (dac != 0 && dac != 1) {
+        return -1;
+    }
+    return AD8802.applyCode(spi, gpio, dacOutput, code, AD8802.chipSelect(dac));
+};
+
+int ControllerBus::readRawDirect(int& raw) {
+    return LTC2380.readRaw(spi, gpio, raw);
+};
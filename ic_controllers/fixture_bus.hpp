@@ -0,0 +1,235 @@
+/*
+ * fixture_bus.hpp:
+ ***********************************************************************
+ * Bus access to the boards of one fixture.
+ *      Everything that drives a fixture, the plan runner, the bus worker,
+ *      the calibrator and the test server, goes through a FixtureBus.
+ *      HandleBus binds the boards through the device handles with the
+ *      wiring fixed at compile time, which is what the default single
+ *      fixture uses. ControllerBus goes through the runtime controllers,
+ *      for fixtures whose wiring is only known at runtime (--fixtures).
+ *      Once a bus owner is attached, calls from any other thread run on
+ *      the owner's thread.
+ ***********************************************************************
+ */
+
+
+#include <cstdint>
+
+#include "bus_owner.hpp"
+#include "device_handle.hpp"
+#include "MCP23S17.hpp"
+#include "AD8802.hpp"
+#include "LTC2380.hpp"
+#include "../hardware_drivers/spi.hpp"
+#include "../hardware_drivers/gpio.hpp"
+
+#ifndef FIXTUREBUS
+#define FIXTUREBUS
+
+/** List of all operations a fixture's bus can execute. */
+typedef enum {
+    BUS_DIO_PORT,
+    BUS_DAC_CODE,
+    BUS_ADC_RAW,
+    BUS_WAIT
+} BusOperationType;
+
+/**
+ * Struct describing a single bus operation, only the fields used by the type need to be set.
+ * @param type the operation to execute.
+ * @param pin any pin on the port, for BUS_DIO_PORT.
+ * @param setMask pins on the port to enable, for BUS_DIO_PORT.
+ * @param clearMask pins on the port to disable, for BUS_DIO_PORT.
+ * @param dac the DAC, 0 or 1, for BUS_DAC_CODE.
+ * @param dacOutput the DAC output channel, 0-11, for BUS_DAC_CODE.
+ * @param code the DAC input value, for BUS_DAC_CODE.
+ * @param waitUs how long the bus is held, for BUS_WAIT.
+ */
+struct BusOperation {
+    BusOperationType type;
+    MCP23S17Controller::DIOPinInfo pin;
+    uint8_t setMask;
+    uint8_t clearMask;
+    int dac;
+    int dacOutput;
+    uint8_t code;
+    int waitUs;
+};
+
+/**
+ * Result of a single bus operation.
+ * @param value the signed 24-bit conversion result for BUS_ADC_RAW, 0 for the others.
+ * @param failed true if a transfer failed or the operation never ran, value is then 0.
+ * @param started CLOCK_MONOTONIC time in nanoseconds the operation started, 0 if it never ran.
+ * @param finished CLOCK_MONOTONIC time in nanoseconds the operation finished, 0 if it never ran.
+ */
+struct BusResult {
+    int32_t value;
+    bool failed;
+    uint64_t started;
+    uint64_t finished;
+};
+
+class FixtureBus {
+    private:
+        /** Thread owning the bus, nullptr if the bus is accessed from the calling thread. */
+        BusOwner* busOwner = nullptr;
+
+    protected:
+        /** The bus access itself, only called by the thread allowed to touch the bus. */
+        virtual int updatePortDirect(MCP23S17Controller::DIOPinInfo pin, uint8_t setMask, uint8_t clearMask) = 0;
+        virtual int applyCodeDirect(int dac, int dacOutput, uint8_t code) = 0;
+        virtual int readRawDirect(int& raw) = 0;
+
+    public:
+        virtual ~FixtureBus() = default;
+
+        /**
+         * Attaches the bus to the thread owning it. Its methods called from other threads then run on that thread.
+         * @param owner the bus owner, or nullptr to access the bus from the calling thread.
+         */
+        virtual void setBusOwner(BusOwner* owner);
+
+        /**
+         * Completes proper intialization procedure to ensure each board is in ready state.
+         * Only called at startup, before a bus owner runs.
+         * @returns -1 if initialization failed.
+         */
+        virtual int initMCP23S17() = 0;
+        virtual int initAD8802() = 0;
+        virtual int initLTC2380() = 0;
+
+        /**
+         * Enables and disables several pins on the same port of one secondary expander with a single read-modify-write.
+         * @param pin any pin on the port, selects the secondary expander and port A or B.
+         * @param setMask pins on the port to enable.
+         * @param clearMask pins on the port to disable.
+         * @returns -1 if a transfer failed.
+         */
+        int updatePort(MCP23S17Controller::DIOPinInfo pin, uint8_t setMask, uint8_t clearMask);
+
+        /** Enables or disables a single DIO pin, @returns -1 if a transfer failed. */
+        int enablePin(MCP23S17Controller::DIOPinInfo pin);
+        int disablePin(MCP23S17Controller::DIOPinInfo pin);
+
+        /**
+         * Applies a DAC input value to a DAC output.
+         * @param dac the DAC, 0 or 1.
+         * @param dacOutput the DAC output channel, 0-11.
+         * @param code the DAC input value, 0-255.
+         * @returns -1 if the DAC does not exist or the transfer failed.
+         */
+        int applyCode(int dac, int dacOutput, uint8_t code);
+
+        /**
+         * Starts an ADC conversion and reads the raw result, scaling is left to LTC2380Controller::scale.
+         * @param raw set to the signed 24-bit conversion result.
+         * @returns -1 if the read failed, raw is then unchanged.
+         */
+        int readRaw(int& raw);
+
+        /**
+         * Executes a single bus operation, timestamping it so results handled later on another
+         * thread still carry the time they happened.
+         * @param op the operation.
+         * @returns the result of the operation.
+         */
+        BusResult execute(const BusOperation& op);
+};
+
+/**
+ * A fixture bound at compile time through the device handles.
+ * @param Backend WiringPiBackend of the fixture's bus.
+ * @param Wiring a FixtureWiring, DefaultWiring for the original fixture on SPI0.
+ * @param Timing the timing profile.
+ */
+template <typename Backend, typename Wiring = DefaultWiring, typename Timing = StandardTiming>
+class HandleBus : public FixtureBus {
+    private:
+        FixtureHandles<Backend, Wiring, Timing> handles;
+
+    protected:
+        int updatePortDirect(MCP23S17Controller::DIOPinInfo pin, uint8_t setMask, uint8_t clearMask) override {
+            TRACE_SCOPE("MCP23S17.updatePort", pin.secondaryExpander);
+            return handles.MCP23S17.updatePort(pin, setMask, clearMask);
+        }
+
+        int applyCodeDirect(int dac, int dacOutput, uint8_t code) override {
+            TRACE_SCOPE("AD8802.applyCode", dacOutput);
+            if (dac == 0) {
+                return handles.DAC1.applyCode(dacOutput, code);
+            }
+            if (dac == 1) {
+                return handles.DAC2.applyCode(dacOutput, code);
+            }
+            return -1;
+        }
+
+        int readRawDirect(int& raw) override {
+            TRACE_SCOPE("LTC2380.readRaw");
+            return handles.LTC2380.readRaw(raw);
+        }
+
+    public:
+        /** @param backend the backend of the fixture's bus. */
+        explicit HandleBus(Backend backend = Backend()) : handles(backend) {
+        }
+
+        int initMCP23S17() override {
+            return handles.MCP23S17.init();
+        }
+
+        int initAD8802() override {
+            // Sets all voltages to 0 initially.
+            int result = 0;
+            for (int dacOutput = 0; dacOutput < 12; dacOutput++) {
+                result |= handles.DAC1.applyCode(dacOutput, 0);
+                result |= handles.DAC2.applyCode(dacOutput, 0);
+            }
+            return result == 0 ? 0 : -1;
+        }
+
+        int initLTC2380() override {
+            return 0;
+        }
+};
+
+/** The original single fixture, DefaultWiring on SPI bus 0 channel 0. */
+typedef HandleBus<WiringPiBackend<0, 0>> DefaultFixtureBus;
+
+/**
+ * A fixture whose wiring is only known at runtime, driven through its runtime controllers.
+ * Attaching a bus owner attaches the controllers too, so they are safe to call directly from any thread.
+ */
+class ControllerBus : public FixtureBus {
+    private:
+        SPIDriver& spi;
+        GPIODriver& gpio;
+        MCP23S17Controller& MCP23S17;
+        AD8802Controller& AD8802;
+        LTC2380Controller& LTC2380;
+
+    protected:
+        int updatePortDirect(MCP23S17Controller::DIOPinInfo pin, uint8_t setMask, uint8_t clearMask) override;
+        int applyCodeDirect(int dac, int dacOutput, uint8_t code) override;
+        int readRawDirect(int& raw) override;
+
+    public:
+        /**
+         * @param spi the SPI driver of the fixture's bus.
+         * @param gpio a GPIO driver.
+         * @param mcp the MCP23S17 controller.
+         * @param dac the AD8802 controller.
+         * @param adc the LTC2380 controller.
+         */
+        ControllerBus(SPIDriver& spi, GPIODriver& gpio, MCP23S17Controller& mcp, AD8802Controller& dac, LTC2380Controller& adc);
+
+        void setBusOwner(BusOwner* owner) override;
+
+        int initMCP23S17() override;
+        int initAD8802() override;
+        int initLTC2380() override;
+};
+
+#endif
@@ -7,35 +7,554 @@
 
 #include <wiringPi.h>
 #include <wiringPiSPI.h>
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <iomanip>
 #include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
 
 #include "hardware_drivers/gpio.hpp"
 #include "hardware_drivers/spi.hpp"
-#include "ic_controllers/MCP23S17.hpp"
-#include "ic_controllers/AD8802.hpp"
+#include "ic_controllers/fixture_bus.hpp"
 #include "ic_controllers/LTC2380.hpp"
+#include "test_framework/bus_worker.hpp"
+#include "test_framework/fixture_scheduler.hpp"
+#include "test_framework/test_plan.hpp"
+#include "test_framework/test_plan_runner.hpp"
+#include "test_framework/result_log.hpp"
+#include "test_framework/bus_cost_model.hpp"
+#include "test_framework/test_server.hpp"
+#include "test_framework/realtime.hpp"
+#include "test_framework/calibrator.hpp"
+#include "ic_controllers/calibration_table.hpp"
+#include "diagnostics/tracer.hpp"
+#include "diagnostics/jitter_benchmark.hpp"
+
+/** The running test server, stopped by SIGINT and SIGTERM. */
+static TestServer* activeServer = nullptr;
+
+static void stopServer(int) {
+    if (activeServer != nullptr) {
+        activeServer->stop();
+    }
+}
 
 class TestProgram {
     private:
         GPIODriver gpio;
         SPIDriver spi;
-        MCP23S17Controller MCP23S17;
-        AD8802Controller AD8802;
+
+        /** The boards of the default fixture, wired at compile time, see device_handle.hpp. */
+        DefaultFixtureBus boards;
+
+        /** Scales the ADC readings, carries the ADC calibration. */
         LTC2380Controller LTC2380;
+
+        /** Owns the SPI bus once the program is running, all bus access goes through it. */
+        BusWorker bus{boards};
+
+        /** The compiled test plan (ITR), memory-mapped. */
+        TestPlan plan;
+        TestPlanRunner runner{boards, LTC2380};
+
+        /** Binary log of every measurement, 2^20 records (32 MB) before it wraps. */
+        ResultLog log;
+        const uint32_t LOG_CAPACITY = 1 << 20;
+
+        /** DAC and ADC calibration, memory-mapped. */
+        CalibrationTable calibration;
+        const char* calibrationPath = nullptr;
+
+        /** Bus timing of the dry run and the test server, the defaults unless a timing file is loaded. */
+        BusCostModel costModel;
+        const char* timingPath = nullptr;
+
+        /** Whether existing result logs are replaced, off so an earlier run's log is never lost by accident. */
+        bool overwriteLogs = false;
+
+        /** Real-time mode settings, see realtime.hpp. */
+        bool realtimeMode = false;
+        RealtimeConfig realtimeConfig;
+
+        /** Jitter benchmark settings, a 1 ms period for 10 s with the 3 other cores loaded. */
+        const int JITTER_PERIOD_US = 1000;
+        const int JITTER_ITERATIONS = 10000;
+        const int JITTER_LOAD_THREADS = 3;
+
+        /**
+         * Loads the calibration file, if one was set.
+         * @returns false if the calibration failed to load.
+         */
+        bool loadCalibration() {
+            if (calibrationPath == nullptr) {
+                return true;
+            }
+
+            if (calibration.load(calibrationPath) == -1) {
+                std::cout << "Calibration " << calibrationPath << " failed to load. Exiting Program.\n";
+                return false;
+            }
+            LTC2380.setVoltageGain(calibration.adcVoltageGain());
+            std::cout << "Calibration loaded.\n";
+            return true;
+        };
+
+        /**
+         * Creates a result log, refusing to replace an existing one unless overwriting was turned on.
+         * @param target the log to open.
+         * @param path the log file.
+         * @returns false if the log could not be created.
+         */
+        bool openLog(ResultLog& target, const std::string& path) {
+            if (target.open(path, LOG_CAPACITY, overwriteLogs) == 0) {
+                return true;
+            }
+            if (errno == EEXIST) {
+                std::cout << "Result log " << path << " already exists, pass --overwrite to replace it. Exiting Program.\n";
+            } else {
+                std::cout << "Result log " << path << " could not be created. Exiting Program.\n";
+            }
+            return false;
+        };
+
+        /**
+         * Locks memory and makes the calling thread a real-time thread, if real-time mode is on.
+         * Failures are printed but not fatal, the test still runs without real-time guarantees.
+         */
+        void enterRealtime() {
+            if (realtimeMode == false) {
+                return;
+            }
+
+            if (Realtime::lockMemory() == -1) {
+                std::cout << "Memory could not be locked, running without locked memory.\n";
+            }
+            if (Realtime::configureThread("main", realtimeConfig.mainCore, realtimeConfig.mainPriority,
+                                          realtimeConfig.stackBytes) == -1) {
+                std::cout << "Main thread running without full real-time settings.\n";
+            } else {
+                std::cout << "Real-time mode enabled.\n";
+            }
+        };
     public:
+        /**
+         * Turns real-time mode on, memory is locked and the main and bus threads are pinned and
+         * run as SCHED_FIFO. Needs root or CAP_SYS_NICE and CAP_IPC_LOCK.
+         * @param enabled whether real-time mode is used.
+         */
+        void setRealtime(bool enabled) {
+            realtimeMode = enabled;
+        };
+
+        /**
+         * Sets whether existing result logs are replaced.
+         * @param enabled true to replace them, false to refuse to run instead.
+         */
+        void setOverwriteLogs(bool enabled) {
+            overwriteLogs = enabled;
+        };
+
+        /**
+         * Sets the calibration file loaded at startup.
+         * @param path the calibration file, nullptr to use the ideal DAC and hand-tuned ADC values.
+         */
+        void setCalibration(const char* path) {
+            calibrationPath = path;
+        };
+
+        /**
+         * Sets the bus timing file loaded by the dry run and the test server, see BusCostModel::load.
+         * @param path the timing file, e.g. one a dry run fitted, nullptr to use the default timing.
+         */
+        void setTiming(const char* path) {
+            timingPath = path;
+        };
+
+        /**
+         * Loads the bus timing file, if one was set.
+         * @returns false if the timing failed to load.
+         */
+        bool loadTiming() {
+            if (timingPath == nullptr) {
+                return true;
+            }
+            if (costModel.load(timingPath) == -1) {
+                std::cout << "Bus timing " << timingPath << " failed to load. Exiting Program.\n";
+                return false;
+            }
+            std::cout << "Bus timing loaded.\n";
+            return true;
+        };
+
+        /**
+         * Runs the DAC to ADC loopback calibration instead of a test. Needs the loopback fixture.
+         * @param path where the calibration file is written.
+         * @param loopbackPath the loopback file with the routing and reference point, see calibrator.hpp.
+         * @returns -1 if the program failed to start, the loopback file is missing or invalid,
+         *     or the calibration could not be written. An existing calibration is only replaced with --overwrite.
+         */
+        int calibrate(const char* path, const char* loopbackPath) {
+            Calibrator calibrator(boards, LTC2380);
+            if (loopbackPath == nullptr) {
+                std::cout << "Calibration needs a loopback file, --loopback <loopback.txt>. Exiting Program.\n";
+                return -1;
+            }
+            if (calibrator.loadLoopback(loopbackPath) == -1) {
+                std::cout << "Loopback file " << loopbackPath << " failed to load. Exiting Program.\n";
+                return -1;
+            }
+
+            if (systemBootupChecks() == false) {
+                std::cout << "Program failed to bootup properly. Exiting Program.\n";
+                return -1;
+            }
+            return calibrator.run(path, overwriteLogs);
+        };
+
+        /**
+         * Checks a loaded calibration against the one the plan's DAC values were compiled with.
+         * A plan compiled with a calibration only runs with that calibration loaded, the ADC would otherwise be uncorrected.
+         * @param loaded id of the loaded calibration, 0 if none is loaded.
+         * @returns false if the plan was compiled for a different calibration or none is loaded.
+         */
+        bool checkPlanCalibration(uint64_t loaded) {
+            if (plan.calibration() == loaded) {
+                return true;
+            }
+            if (plan.calibration() != 0 && loaded != 0) {
+                std::cout << "Test plan was compiled with calibration " << plan.calibration() << " but calibration "
+                          << loaded << " is loaded, recompile the plan.\n";
+                return false;
+            }
+            if (plan.calibration() != 0) {
+                std::cout << "Test plan was compiled with calibration " << plan.calibration()
+                          << " but no calibration is loaded, run it with the same calibration.\n";
+                return false;
+            }
+            std::cout << "Warning: the plan's DAC values were compiled without a calibration, the calibration only "
+                      << "corrects the ADC. Recompile with ./plan_compiler recipe.txt plan.bin cal.bin.\n";
+            return true;
+        };
+
+        /**
+         * Runs the jitter benchmark instead of a test, in real-time mode if it is on.
+         * @param togglePin a free GPIO pin toggled on every wakeup.
+         * @returns -1 if the program failed to start.
+         */
+        int jitterBenchmark(int togglePin) {
+            enterRealtime();
+
+            if (systemBootupChecks() == false) {
+                std::cout << "Program failed to bootup properly. Exiting Program.\n";
+                return -1;
+            }
+
+            JitterBenchmark benchmark(gpio, togglePin);
+            benchmark.run(JITTER_PERIOD_US, JITTER_ITERATIONS, JITTER_LOAD_THREADS);
+            benchmark.report();
+            return 0;
+        };
+
+        /**
+         * Runs as a test server instead of running a plan, until SIGINT or SIGTERM.
+         * Other tools then share the fixture through the socket, see test_framework/server_protocol.hpp.
+         * @param socketPath the Unix domain socket clients connect to.
+         * @param logPath where the binary result log is written, nullptr to not log.
+         * @returns -1 if the program failed to start or the socket could not be created.
+         */
+        int serve(const char* socketPath, const char* logPath) {
+            enterRealtime();
+
+            if (systemBootupChecks() == false) {
+                std::cout << "Program failed to bootup properly. Exiting Program.\n";
+                return -1;
+            }
+            if (loadCalibration() == false || loadTiming() == false) {
+                return -1;
+            }
+
+            TestServer server(boards, LTC2380);
+            server.setCostModel(costModel);
+            if (logPath != nullptr) {
+                if (openLog(log, logPath) == false) {
+                    return -1;
+                }
+                server.setLog(&log);
+            }
+            if (server.open(socketPath) == -1) {
+                std::cout << "Test server could not be started. Exiting Program.\n";
+                return -1;
+            }
+
+            activeServer = &server;
+            signal(SIGINT, stopServer);
+            signal(SIGTERM, stopServer);
+            std::cout << "Serving on " << socketPath << ".\n";
+
+            int result = server.serve();
+
+            activeServer = nullptr;
+            server.close();
+            log.close();
+            std::cout << "Test server stopped.\n";
+            return result;
+        };
+
+        /**
+         * Predicts the cycle time of a test plan without touching the hardware.
+         * Prints the predicted time of every step. Given the log of a real run it also prints the measured
+         * time, fits the bus timing to it, prints the fitted prediction and writes the fitted timing next to
+         * the log as <log>.timing, see BusCostModel::fit. Predictions start from the timing file, if one is set.
+         * @param planPath the compiled test plan.
+         * @param measuredLogPath result log of a real run of the same plan, nullptr to only predict.
+         * @returns -1 if the plan, the log or the timing could not be loaded, or the fitted timing could not be written.
+         */
+        int dryRun(const char* planPath, const char* measuredLogPath) {
+            if (plan.load(planPath) == -1) {
+                std::cout << "Test plan " << planPath << " failed to load. Exiting Program.\n";
+                return -1;
+            }
+            if (loadTiming() == false) {
+                return -1;
+            }
+
+            const BusCostModel& model = costModel;
+            std::vector<double> predicted = model.stepTimes(plan);
+
+            // Measured step times are the gaps between the STEP records of the log. The last step has no STEP
+            //   record after it and its last record is written before its final operation ends, so it is not measured.
+            std::vector<double> measured(predicted.size(), -1.0);
+            BusCostModel fitted = model;
+            bool fittedOk = false;
+            if (measuredLogPath != nullptr) {
+                ResultLogReader measuredLog;
+                if (measuredLog.load(measuredLogPath) == -1) {
+                    std::cout << "Result log " << measuredLogPath << " failed to load. Exiting Program.\n";
+                    return -1;
+                }
+                int64_t step = -1;
+                uint64_t stepStart = 0;
+                for (uint64_t i = 0; i < measuredLog.count(); i++) {
+                    const LogRecord& record = measuredLog.record(i);
+                    if (record.event != LOG_STEP) {
+                        continue;
+                    }
+                    if (step >= 0 && (size_t)step < measured.size()) {
+                        measured[step] = (record.timestamp - stepStart) / 1000.0;
+                    }
+                    step = record.step;
+                    stepStart = record.timestamp;
+                }
+                fittedOk = fitted.fit(plan, measured) == 0;
+            }
+            std::vector<double> fittedSteps = fitted.stepTimes(plan);
+
+            std::cout << std::fixed << std::setprecision(1);
+            std::cout << std::setw(8) << "Step" << std::setw(16) << "Predicted us";
+            if (measuredLogPath != nullptr) {
+                std::cout << std::setw(16) << "Measured us" << std::setw(12) << "Error %";
+                if (fittedOk) {
+                    std::cout << std::setw(16) << "Fitted us" << std::setw(12) << "Error %";
+                }
+            }
+            std::cout << "\n";
+
+            double predictedTotal = 0, measuredTotal = 0, comparedTotal = 0, fittedTotal = 0;
+            for (size_t step = 0; step < predicted.size(); step++) {
+                predictedTotal += predicted[step];
+                std::cout << std::setw(8) << step << std::setw(16) << predicted[step];
+                if (measuredLogPath != nullptr && measured[step] >= 0) {
+                    measuredTotal += measured[step];
+                    comparedTotal += predicted[step];
+                    fittedTotal += fittedSteps[step];
+                    std::cout << std::setw(16) << measured[step] << std::setw(12)
+                              << (measured[step] > 0 ? (predicted[step] - measured[step]) / measured[step] * 100 : 0.0);
+                    if (fittedOk) {
+                        std::cout << std::setw(16) << fittedSteps[step] << std::setw(12)
+                                  << (measured[step] > 0 ? (fittedSteps[step] - measured[step]) / measured[step] * 100 : 0.0);
+                    }
+                }
+                std::cout << "\n";
+            }
+
+            std::cout << "Predicted cycle time: " << predictedTotal / 1000.0 << " ms.\n";
+            if (measuredLogPath != nullptr && measuredTotal > 0) {
+                std::cout << "Measured cycle time:  " << measuredTotal / 1000.0 << " ms, prediction off by "
+                          << (comparedTotal - measuredTotal) / measuredTotal * 100 << "% over the measured steps.\n";
+            }
+            if (measuredLogPath != nullptr && fittedOk == false) {
+                std::cout << "Bus timing could not be fitted, the log has no measured step with bus overhead.\n";
+            } else if (fittedOk) {
+                const BusTiming& timing = fitted.timing();
+                std::cout << std::setprecision(3) << "Fitted bus timing: frameOverheadUs " << timing.frameOverheadUs
+                          << ", gpioWriteUs " << timing.gpioWriteUs << ", sleepOverheadUs " << timing.sleepOverheadUs
+                          << ", fitted prediction off by " << std::setprecision(1)
+                          << (fittedTotal - measuredTotal) / measuredTotal * 100 << "% over the measured steps.\n";
+
+                // Kept so later dry runs, the plan compiler and the test server predict with the fitted timing.
+                std::string fittedPath = std::string(measuredLogPath) + ".timing";
+                if (fitted.save(fittedPath, overwriteLogs) == -1) {
+                    if (errno == EEXIST) {
+                        std::cout << "Bus timing " << fittedPath << " already exists, use --overwrite to replace it.\n";
+                    } else {
+                        std::cout << "Bus timing " << fittedPath << " could not be written.\n";
+                    }
+                    return -1;
+                }
+                std::cout << "Fitted bus timing written to " << fittedPath << ", use it with --timing.\n";
+            }
+            return 0;
+        };
+
         /**
          * Main program--executes all logic.
+         * @param planPath the compiled test plan to run.
+         * @param logPath where the binary result log is written, nullptr to not log.
+         * @param tracePath where the Chrome trace of the run is written, nullptr to not trace.
+         * @returns -1 if the program failed to start or the test failed.
          */
-        void run() {
-            
+        int run(const char* planPath, const char* logPath, const char* tracePath) {
+            // First, so the plan and log mappings are locked in memory as well.
+            enterRealtime();
+
+            if (preExecutionChecks(planPath) == false) {
+                return -1;
+            }
+
+            if (logPath != nullptr) {
+                if (openLog(log, logPath) == false) {
+                    return -1;
+                }
+                runner.setLog(&log);
             }
+
+            if (tracePath != nullptr) {
+                Tracer::start();
+                Tracer::nameThread("main");
+            }
+
+            // From here on the boards are only used from the bus-owner thread.
+            if (realtimeMode) {
+                bus.startRealtime(realtimeConfig.busCore, realtimeConfig.busPriority, realtimeConfig.stackBytes);
+            } else {
+                bus.start();
+            }
+
+            // Steps run on the bus thread, their limits are checked and logged here.
+            int result = runner.run(plan, bus);
+            if (result == -1) {
+                std::cout << "Test failed, " << runner.failures() << " measurement(s) out of limits, first in step "
+                          << runner.firstFailure() << ".\n";
+            } else {
+                std::cout << "Test passed.\n";
+            }
+
+            bus.stop();
+            log.close();
+
+            if (tracePath != nullptr) {
+                Tracer::stop();
+                if (Tracer::exportChromeTrace(tracePath) == -1) {
+                    std::cout << "Trace " << tracePath << " could not be written.\n";
+                } else {
+                    std::cout << "Trace written to " << tracePath << ".\n";
+                }
+            }
+            return result;
         };
 
 
+        /**
+         * Runs a test plan on several fixtures at once, one pinned session thread per fixture.
+         * The default fixture wiring is not used, every fixture comes from the fixture file.
+         * @param planPath the compiled test plan to run on every fixture.
+         * @param logPath base name of the result logs, each fixture logs to logPath.busN, nullptr to not log.
+         * @param fixturesPath the fixture file, see FixtureScheduler::loadFixtures.
+         * @returns -1 if the program failed to start or the test failed on any fixture.
+         */
+        int runFixtures(const char* planPath, const char* logPath, const char* fixturesPath) {
+            FixtureScheduler scheduler(gpio);
+            if (scheduler.loadFixtures(fixturesPath) == -1 || scheduler.fixtureCount() == 0) {
+                std::cout << "Fixtures " << fixturesPath << " failed to load. Exiting Program.\n";
+                return -1;
+            }
+
+            if (wiringPiSetup() == -1 || gpio.initGPIO(scheduler.reservedPins()) == -1) {
+                std::cout << "RaspberryPi GPIO Driver setup failed. Exiting Program.\n";
+                return -1;
+            }
+            if (scheduler.initFixtures() == -1) {
+                std::cout << "Program failed to bootup properly. Exiting Program.\n";
+                return -1;
+            }
+
+            if (plan.load(planPath) == -1) {
+                std::cout << "Test plan " << planPath << " failed to load. Exiting Program.\n";
+                return -1;
+            }
+            std::cout << "Test plan loaded, " << plan.stepCount() << " steps, running on "
+                      << scheduler.fixtureCount() << " fixtures.\n";
+            // Every fixture has its own calibration from the fixture file, each must match the plan.
+            bool calibrated = true;
+            for (int i = 0; i < scheduler.fixtureCount(); i++) {
+                if (checkPlanCalibration(scheduler.fixture(i).calibrationId()) == false) {
+                    std::cout << "Fixture on SPI bus " << scheduler.fixture(i).config.spiBus << " cannot run the plan.\n";
+                    calibrated = false;
+                }
+            }
+            if (calibrated == false) {
+                std::cout << "Exiting Program.\n";
+                return -1;
+            }
+
+            // Logs are opened up front so a session never fails halfway through setup.
+            std::vector<std::unique_ptr<ResultLog>> logs;
+            for (int i = 0; i < scheduler.fixtureCount(); i++) {
+                logs.push_back(std::unique_ptr<ResultLog>(new ResultLog()));
+                if (logPath == nullptr) {
+                    continue;
+                }
+                std::string path = std::string(logPath) + ".bus" + std::to_string(scheduler.fixture(i).config.spiBus);
+                if (openLog(*logs[i], path) == false) {
+                    return -1;
+                }
+            }
+
+            std::vector<int> results = scheduler.run([this, &scheduler, &logs](Fixture& fixture) {
+                int index = 0;
+                while (&scheduler.fixture(index) != &fixture) {
+                    index++;
+                }
+                // The session thread owns this fixture's bus, so the runner uses it directly.
+                TestPlanRunner fixtureRunner(fixture.boards, fixture.LTC2380);
+                if (logs[index]->isOpen()) {
+                    fixtureRunner.setLog(logs[index].get());
+                }
+                int result = fixtureRunner.run(plan);
+                if (result == -1) {
+                    std::cout << "Fixture on SPI bus " << fixture.config.spiBus << ": test failed, " << fixtureRunner.failures()
+                              << " measurement(s) out of limits, first in step " << fixtureRunner.firstFailure() << ".\n";
+                } else {
+                    std::cout << "Fixture on SPI bus " << fixture.config.spiBus << ": test passed.\n";
+                }
+                return result;
+            });
+
+            for (std::unique_ptr<ResultLog>& fixtureLog : logs) {
+                fixtureLog->close();
+            }
+            return std::find(results.begin(), results.end(), -1) == results.end() ? 0 : -1;
+        };
+
         /** 
          * Ensures all bootups are successful, ITR is loaded, and user input is provided.
+         * @param planPath the compiled test plan to load.
          */
-        bool preExecutionChecks() {
+        bool preExecutionChecks(const char* planPath) {
             // Some safety and configuration steps prior to running tests.
             if (systemBootupChecks() == false) {
                 std::cout << "Program failed to bootup properly. Exiting Program.\n";
@@ -44,6 +563,22 @@ class TestProgram {
                 std::cout << "Program bootup successful.\n";
             }
 
+            if (loadCalibration() == false) {
+                return false;
+            }
+
+            if (plan.load(planPath) == -1) {
+                std::cout << "Test plan " << planPath << " failed to load. Exiting Program.\n";
+                return false;
+            } else {
+                std::cout << "Test plan loaded, " << plan.stepCount() << " steps.\n";
+            }
+
+            if (checkPlanCalibration(calibration.loaded() ? calibration.created() : 0) == false) {
+                std::cout << "Exiting Program.\n";
+                return false;
+            }
+
             return true;
         };
 
@@ -82,21 +617,21 @@ class TestProgram {
 
             // Stage 3: Setup boards.
             if (passedChecks) {
-                if (dio.initMCP23S17(spi, gpio) == -1) {
+                if (boards.initMCP23S17() == -1) {
                     std::cout << "MCP23S17 Board setup failed.\n";
                     passedChecks = false;
                 } else {
                     std::cout << "MCP23S17 Board setup successful.\n";
                 }
 
-                if (psu.initAD8802(spi, gpio) == -1) {
+                if (boards.initAD8802() == -1) {
                     std::cout << "AD8802 Board setup failed.\n";
                     passedChecks = false;
                 } else {
                     std::cout << "PAD8802SU Board setup sucessful.\n";
                 }
 
-                if (dmm.initLTC2380(spi, gpio) == -1) {
+                if (boards.initLTC2380() == -1) {
                     std::cout << "LTC2380 Board setup failed.\n";
                     passedChecks = false;
                 } else {
@@ -110,9 +645,157 @@ class TestProgram {
 };
 
 
-int main(void) {
+/** Prints every way the program can be run. */
+/**
+ * Checks a pin the jitter benchmark may toggle.
+ * @param pin a wiringPi pin number.
+ * @returns false if the pin is not a GPIO output pin, or drives the default fixture's boards or its SPI bus.
+ */
+static bool jitterPinFree(int pin) {
+    if (!GPIODriver::isOutputPin(pin)) {
+        return false;
+    }
+    const int boardPins[6] = {DefaultWiring::Expander1Cs::PIN, DefaultWiring::Expander2Cs::PIN, DefaultWiring::Dac1Cs::PIN,
+                              DefaultWiring::Dac2Cs::PIN, DefaultWiring::AdcSdi::PIN, DefaultWiring::ADC_CNV};
+    std::vector<int> busPins = SPIDriver::busPins(0);
+    return std::find(std::begin(boardPins), std::end(boardPins), pin) == std::end(boardPins)
+        && std::find(busPins.begin(), busPins.end(), pin) == busPins.end();
+}
+
+static void printUsage(const char* program) {
+    std::cout << "Usage: " << program << " <plan.bin> [log.bin] [--overwrite] [--trace trace.json] [--realtime] [--calibration cal.bin]\n";
+    std::cout << "       " << program << " --jitter <free gpio pin> [--realtime]\n";
+    std::cout << "       " << program << " <plan.bin> [log.bin] [--overwrite] --fixtures <fixtures.txt>\n";
+    std::cout << "       " << program << " <plan.bin> [measured log.bin] [--overwrite] [--timing bus.timing] --dry-run\n";
+    std::cout << "       " << program << " --calibrate <cal.bin> --loopback <loopback.txt> [--overwrite]\n";
+    std::cout << "       " << program << " --serve <socket> [--log log.bin] [--overwrite] [--realtime] [--calibration cal.bin] [--timing bus.timing]\n";
+}
+
+int main(int argc, char** argv) {
+    const char* planPath = nullptr;
+    const char* logPath = nullptr;
+    const char* tracePath = nullptr;
+    bool realtime = false;
+    bool dryRun = false;
+    bool overwrite = false;
+    int jitterPin = -1;
+    const char* calibrationPath = nullptr;
+    const char* calibrateOutput = nullptr;
+    const char* loopbackPath = nullptr;
+    const char* socketPath = nullptr;
+    const char* serveLogPath = nullptr;
+    const char* fixturesPath = nullptr;
+    const char* timingPath = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--trace" && i + 1 < argc) {
+            tracePath = argv[++i];
+        } else if (arg == "--realtime") {
+            realtime = true;
+        } else if (arg == "--overwrite") {
+            overwrite = true;
+        } else if (arg == "--dry-run") {
+            dryRun = true;
+        } else if (arg == "--jitter" && i + 1 < argc) {
+            char* end;
+            long pin = strtol(argv[++i], &end, 10);
+            if (end == argv[i] || *end != '\0' || pin < 0 || pin > 31 || !jitterPinFree(pin)) {
+                std::cout << "Invalid GPIO pin for --jitter: " << argv[i] << ", it must be a free GPIO output pin, "
+                          << "not a CS/CNV pin of the fixture or a pin of SPI bus 0.\n";
+                printUsage(argv[0]);
+                return 1;
+            }
+            jitterPin = pin;
+        } else if (arg == "--calibration" && i + 1 < argc) {
+            calibrationPath = argv[++i];
+        } else if (arg == "--calibrate" && i + 1 < argc) {
+            calibrateOutput = argv[++i];
+        } else if (arg == "--loopback" && i + 1 < argc) {
+            loopbackPath = argv[++i];
+        } else if (arg == "--serve" && i + 1 < argc) {
+            socketPath = argv[++i];
+        } else if (arg == "--log" && i + 1 < argc) {
+            serveLogPath = argv[++i];
+        } else if (arg == "--fixtures" && i + 1 < argc) {
+            fixturesPath = argv[++i];
+        } else if (arg == "--timing" && i + 1 < argc) {
+            timingPath = argv[++i];
+        } else if (planPath == nullptr) {
+            planPath = argv[i];
+        } else if (logPath == nullptr) {
+            logPath = argv[i];
+        } else {
+            planPath = nullptr;
+            break;
+        }
+    }
+
     TestProgram test;
-    test.run();
+    test.setRealtime(realtime);
+    test.setCalibration(calibrationPath);
+    test.setOverwriteLogs(overwrite);
+    test.setTiming(timingPath);
+
+    // Only the dry run and the test server predict bus time.
+    if (timingPath != nullptr && !dryRun && socketPath == nullptr) {
+        std::cout << "--timing is only used with --dry-run and --serve.\n";
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    if (calibrateOutput != nullptr) {
+        return test.calibrate(calibrateOutput, loopbackPath) == -1 ? 1 : 0;
+    }
+
+    if (socketPath != nullptr) {
+        // The server runs no plan, a stray plan path must not end up as anything else.
+        if (planPath != nullptr) {
+            std::cout << "--serve takes no test plan, the result log is given with --log.\n";
+            printUsage(argv[0]);
+            return 1;
+        }
+        return test.serve(socketPath, serveLogPath) == -1 ? 1 : 0;
+    }
+
+    if (serveLogPath != nullptr) {
+        std::cout << "--log is only used with --serve.\n";
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    if (jitterPin != -1) {
+        return test.jitterBenchmark(jitterPin) == -1 ? 1 : 0;
+    }
+
+    if (planPath == nullptr) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    if (dryRun) {
+        return test.dryRun(planPath, logPath) == -1 ? 1 : 0;
+    }
+
+    if (fixturesPath != nullptr) {
+        // Every fixture has its own boards, so each names its own calibration in the fixture file.
+        if (calibrationPath != nullptr) {
+            std::cout << "--calibration is not used with --fixtures, give each fixture's calibration in the fixture file.\n";
+            printUsage(argv[0]);
+            return 1;
+        }
+        // Sessions pin their own threads and are not traced, neither option would do anything.
+        if (realtime || tracePath != nullptr) {
+            std::cout << "--realtime and --trace are not used with --fixtures.\n";
+            printUsage(argv[0]);
+            return 1;
+        }
+        return test.runFixtures(planPath, logPath, fixturesPath) == -1 ? 1 : 0;
+    }
+
+    if (test.run(planPath, logPath, tracePath) == -1) {
+        return 1;
+    }
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,274 @@
+/*
+ * bus_cost_model.cpp:
+ ***********************************************************************
+ * Bus-time cost model of the board controllers.
+ *      Each operation is broken down into the same frames, GPIO writes
+ *      and delays the controllers perform, see MCP23S17.cpp, AD8802.cpp
+ *      and LTC2380.cpp.
+ ***********************************************************************
+ */
+
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <utility>
+
+#include "bus_cost_model.hpp"
+
+
+/** The overheads fitted to measured runs, everything else in BusTiming is known. */
+static double BusTiming::* const FITTED_TIMING[] = {
+    &BusTiming::frameOverheadUs, &BusTiming::gpioWriteUs, &BusTiming::sleepOverheadUs
+};
+static const int FITTED_COUNT = 3;
+
+/** Every BusTiming member by the name timing files use for it. */
+static const struct {
+    const char* name;
+    double BusTiming::* field;
+} TIMING_FIELDS[] = {
+    {"spiClockHz", &BusTiming::spiClockHz},
+    {"frameOverheadUs", &BusTiming::frameOverheadUs},
+    {"gpioWriteUs", &BusTiming::gpioWriteUs},
+    {"csDelayUs", &BusTiming::csDelayUs},
+    {"sleepOverheadUs", &BusTiming::sleepOverheadUs},
+    {"cnvPulseUs", &BusTiming::cnvPulseUs}
+};
+
+BusCostModel::BusCostModel(const BusTiming& timing) : busTiming(timing) {
+};
+
+const BusTiming& BusCostModel::timing() const {
+    return busTiming;
+};
+
+double BusCostModel::frameUs(int bytes) const {
+    return busTiming.frameOverheadUs + bytes * 8 * 1000000.0 / busTiming.spiClockHz;
+};
+
+double BusCostModel::delayUs(double microseconds) const {
+    if (microseconds <= 0) {
+        return 0;
+    }
+    return microseconds < 100 ? microseconds : microseconds + busTiming.sleepOverheadUs;
+};
+
+double BusCostModel::primaryWriteUs() const {
+    return 2*busTiming.gpioWriteUs + 2*delayUs(busTiming.csDelayUs) + frameUs(3);
+};
+
+double BusCostModel::dioUs() const {
+    // Select the secondary, read its latch, deselect, select, write, deselect.
+    return 4*primaryWriteUs() + 2*frameUs(3);
+};
+
+double BusCostModel::dacUs() const {
+    return 2*busTiming.gpioWriteUs + frameUs(2);
+};
+
+double BusCostModel::adcUs() const {
+    // CNV edges, CS edges and the 5 byte result frame.
+    return 4*busTiming.gpioWriteUs + busTiming.cnvPulseUs + frameUs(5);
+};
+
+double BusCostModel::instructionUs(const PlanInstruction& instruction) const {
+    switch (instruction.opcode) {
+        case PLAN_DIO_ON:
+        case PLAN_DIO_OFF:
+        case PLAN_DIO_PORT:
+            return dioUs();
+        case PLAN_DAC:
+            return dacUs();
+        case PLAN_ADC:
+            return adcUs();
+        case PLAN_WAIT:
+            return delayUs(instruction.low);
+    }
+    return 0;
+};
+
+std::vector<double> BusCostModel::stepTimes(const TestPlan& plan) const {
+    std::vector<double> steps(plan.stepCount(), 0.0);
+
+    const PlanInstruction* instructions = plan.instructions();
+    for (uint32_t i = 0; i < plan.instructionCount(); i++) {
+        if (instructions[i].step < steps.size()) {
+            steps[instructions[i].step] += instructionUs(instructions[i]);
+        }
+    }
+
+    return steps;
+};
+
+double BusCostModel::totalUs(const std::vector<PlanInstruction>& instructions) const {
+    double total = 0;
+    for (const PlanInstruction& instruction : instructions) {
+        total += instructionUs(instruction);
+    }
+    return total;
+};
+
+int BusCostModel::fit(const TestPlan& plan, const std::vector<double>& measured) {
+    // Predicted time is linear in each overhead, so a step's coefficient for an overhead is how much
+    //   its predicted time grows when that overhead grows by 1 us with the others at 0.
+    BusTiming zero = busTiming;
+    for (int p = 0; p < FITTED_COUNT; p++) {
+        zero.*FITTED_TIMING[p] = 0;
+    }
+    std::vector<double> known = BusCostModel(zero).stepTimes(plan);
+    std::vector<double> coefficients[FITTED_COUNT];
+    for (int p = 0; p < FITTED_COUNT; p++) {
+        BusTiming unit = zero;
+        unit.*FITTED_TIMING[p] = 1;
+        coefficients[p] = BusCostModel(unit).stepTimes(plan);
+        for (size_t step = 0; step < known.size(); step++) {
+            coefficients[p][step] -= known[step];
+        }
+    }
+
+    // Normal equations of the least squares fit, the last column holds the right hand side.
+    double normal[FITTED_COUNT][FITTED_COUNT + 1] = {};
+    int measuredSteps = 0;
+    for (size_t step = 0; step < known.size() && step < measured.size(); step++) {
+        if (measured[step] < 0) {
+            continue;
+        }
+        measuredSteps++;
+        for (int i = 0; i < FITTED_COUNT; i++) {
+            for (int j = 0; j < FITTED_COUNT; j++) {
+                normal[i][j] += coefficients[i][step] * coefficients[j][step];
+            }
+            normal[i][FITTED_COUNT] += coefficients[i][step] * (measured[step] - known[step]);
+        }
+    }
+    if (measuredSteps == 0) {
+        return -1;
+    }
+
+    // Gaussian elimination with partial pivoting, a pivot near 0 means the steps do not separate the overheads.
+    double largest = 0;
+    for (int i = 0; i < FITTED_COUNT; i++) {
+        largest = std::fmax(largest, normal[i][i]);
+    }
+    bool separable = measuredSteps >= FITTED_COUNT && largest > 0;
+    for (int column = 0; column < FITTED_COUNT && separable; column++) {
+        int pivot = column;
+        for (int row = column + 1; row < FITTED_COUNT; row++) {
+            if (std::fabs(normal[row][column]) > std::fabs(normal[pivot][column])) {
+                pivot = row;
+            }
+        }
+        if (std::fabs(normal[pivot][column]) < 1e-9 * largest) {
+            separable = false;
+            break;
+        }
+        for (int k = 0; k <= FITTED_COUNT; k++) {
+            std::swap(normal[column][k], normal[pivot][k]);
+        }
+        for (int row = 0; row < FITTED_COUNT; row++) {
+            if (row == column) {
+                continue;
+            }
+            double factor = normal[row][column] / normal[column][column];
+            for (int k = column; k <= FITTED_COUNT; k++) {
+                normal[row][k] -= factor * normal[column][k];
+            }
+        }
+    }
+
+    if (separable) {
+        BusTiming fitted = busTiming;
+        bool positive = true;
+        for (int p = 0; p < FITTED_COUNT; p++) {
+            fitted.*FITTED_TIMING[p] = normal[p][FITTED_COUNT] / normal[p][p];
+            positive = positive && fitted.*FITTED_TIMING[p] > 0;
+        }
+        if (positive) {
+            busTiming = fitted;
+            return 0;
+        }
+    }
+
+    // One common scale of the current overheads, always separable if the steps have any overhead at all.
+    double numerator = 0, denominator = 0;
+    for (size_t step = 0; step < known.size() && step < measured.size(); step++) {
+        if (measured[step] < 0) {
+            continue;
+        }
+        double overhead = 0;
+        for (int p = 0; p < FITTED_COUNT; p++) {
+            overhead += coefficients[p][step] * busTiming.*FITTED_TIMING[p];
+        }
+        numerator += overhead * (measured[step] - known[step]);
+        denominator += overhead * overhead;
+    }
+    if (denominator <= 0 || numerator <= 0) {
+        return -1;
+    }
+    for (int p = 0; p < FITTED_COUNT; p++) {
+        busTiming.*FITTED_TIMING[p] *= numerator / denominator;
+    }
+    return 0;
+};
+
+int BusCostModel::load(const std::string& path) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        return -1;
+    }
+
+    BusTiming loaded = busTiming;
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream tokens(line);
+        std::string name;
+        if (!(tokens >> name) || name[0] == '#') {
+            continue;
+        }
+        double value;
+        std::string extra;
+        if (!(tokens >> value) || (tokens >> extra) || !std::isfinite(value) || value < 0) {
+            return -1;
+        }
+        bool known = false;
+        for (const auto& field : TIMING_FIELDS) {
+            if (name == field.name) {
+                loaded.*field.field = value;
+                known = true;
+            }
+        }
+        if (!known) {
+            return -1;
+        }
+    }
+    if (file.bad() || loaded.spiClockHz <= 0) {
+        return -1;
+    }
+
+    busTiming = loaded;
+    return 0;
+};
+
+int BusCostModel::save(const std::string& path, bool overwrite) const {
+    // Like result logs, an existing file is only replaced when asked to.
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | (overwrite ? O_TRUNC : O_EXCL), 0644);
+    if (fd < 0) {
+        return -1;
+    }
+    FILE* out = fdopen(fd, "w");
+    if (out == nullptr) {
+        close(fd);
+        return -1;
+    }
+
+    fprintf(out, "# Bus timing for BusCostModel, in microseconds unless named otherwise.\n");
+    for (const auto& field : TIMING_FIELDS) {
+        fprintf(out, "%s %.17g\n", field.name, busTiming.*field.field);
+    }
+    bool written = ferror(out) == 0;
+    return fclose(out) == 0 && written ? 0 : -1;
+};
@@ -0,0 +1,133 @@
+/*
+ * bus_cost_model.hpp:
+ ***********************************************************************
+ * Bus-time cost model of the board controllers.
+ *      Predicts how long each compiled plan instruction keeps the bus
+ *      busy from the SPI frames it sends, the bytes in each frame at the
+ *      configured SPI clock, the CS delays in MCP23S17.cpp, GPIO writes
+ *      and the LTC2380 conversion pulse. Used for dry runs, so the cycle
+ *      time of a recipe is known before it ties up a station, and by the
+ *      plan compiler to report what scheduling saves. The overheads can
+ *      be fitted to the step times of a measured run, and the timing is
+ *      saved to and loaded from a text file, one "name value" per line.
+ ***********************************************************************
+ */
+
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "test_plan.hpp"
+
+#ifndef BUSCOSTMODEL
+#define BUSCOSTMODEL
+
+/**
+ * Timing of the bus primitives, in microseconds unless named otherwise.
+ * Defaults follow the constants in the drivers and controllers, the overheads
+ * are typical RPi values, see BusCostModel::fit for fitting them to a measured run.
+ * @param spiClockHz SPI clock, SPIDriver::SPI_BAUDRATE.
+ * @param frameOverheadUs fixed cost of a single spidev transfer, the ioctl and DMA setup.
+ * @param gpioWriteUs a single digitalWrite, used for every CS and CNV edge.
+ * @param csDelayUs StandardTiming::EXPANDER_CS_DELAY_US, waited on both sides of every primary transfer.
+ * @param sleepOverheadUs added to every delay of 100 us or more, wiringPi sleeps those instead of spinning.
+ * @param cnvPulseUs the LTC2380 CNV pulse. readRaw does not wait for BUSY, so this is all the conversion costs.
+ */
+struct BusTiming {
+    double spiClockHz = 8000000;
+    double frameOverheadUs = 10.0;
+    double gpioWriteUs = 0.1;
+    double csDelayUs = 100.0;
+    double sleepOverheadUs = 60.0;
+    double cnvPulseUs = 0.03;
+};
+
+class BusCostModel {
+    private:
+        BusTiming busTiming;
+
+        /**
+         * @param bytes bytes in the frame.
+         * @returns time of a single SPI transfer.
+         */
+        double frameUs(int bytes) const;
+
+        /**
+         * @param microseconds the requested delay.
+         * @returns time delayMicroseconds actually takes.
+         */
+        double delayUs(double microseconds) const;
+
+    public:
+        /** Uses the default timing. */
+        BusCostModel() = default;
+
+        /**
+         * Uses measured or tuned timing.
+         * @param timing the timing of the bus primitives.
+         */
+        explicit BusCostModel(const BusTiming& timing);
+
+        /** @returns the timing the model predicts with. */
+        const BusTiming& timing() const;
+
+        /** @returns time of one primary expander write, CS low, delay, 3 byte frame, delay, CS high. */
+        double primaryWriteUs() const;
+
+        /** @returns time of MCP23S17Controller::updatePort, which enablePin and disablePin also use. */
+        double dioUs() const;
+
+        /** @returns time of AD8802Controller::applyCode. */
+        double dacUs() const;
+
+        /** @returns time of LTC2380Controller::readRaw. */
+        double adcUs() const;
+
+        /**
+         * @param instruction a compiled plan instruction.
+         * @returns predicted time of the instruction.
+         */
+        double instructionUs(const PlanInstruction& instruction) const;
+
+        /**
+         * Walks a compiled plan through the model.
+         * @param plan a loaded test plan.
+         * @returns predicted time of every step, indexed by step.
+         */
+        std::vector<double> stepTimes(const TestPlan& plan) const;
+
+        /**
+         * @param instructions compiled plan instructions, in execution order.
+         * @returns predicted time of all of them.
+         */
+        double totalUs(const std::vector<PlanInstruction>& instructions) const;
+
+        /**
+         * Fits frameOverheadUs, gpioWriteUs and sleepOverheadUs to the step times of a measured run by least squares.
+         * The SPI clock and the delays the code asks for are known and kept. If the measured steps cannot tell the
+         * three overheads apart, e.g. every step runs the same operations, they are scaled by one common factor instead.
+         * @param plan the plan of the measured run.
+         * @param measured measured time of every step in microseconds, indexed by step, negative if the step was not measured.
+         * @returns -1 if no step was measured or no fit with positive overheads exists, the timing is then unchanged.
+         */
+        int fit(const TestPlan& plan, const std::vector<double>& measured);
+
+        /**
+         * Loads timing written by save. Names missing from the file keep their current value.
+         * @param path the timing file, one "<BusTiming member> <value>" per line, # starts a comment.
+         * @returns -1 if the file could not be read, names an unknown member, or has a value that is negative,
+         *     not a number, or a zero SPI clock. The timing is then unchanged.
+         */
+        int load(const std::string& path);
+
+        /**
+         * Writes every member of the timing, one "<BusTiming member> <value>" per line.
+         * @param path the timing file.
+         * @param overwrite true to replace an existing file, otherwise an existing file is left alone.
+         * @returns -1 if the file exists and overwrite is false (errno is then EEXIST), or could not be written.
+         */
+        int save(const std::string& path, bool overwrite = false) const;
+};
+
+#endif
@@ -0,0 +1,281 @@
+/*
+ * bus_worker.cpp:
+ ***********************************************************************
+ * Bus-owner thread for the SPI bus.
+ *      All DIO, DAC and ADC operations are queued to a single thread which
+ *      is the only one allowed to touch the SPI bus and CS pins. Callers get
+ *      a future or callback back, so test logic can continue while the bus
+ *      is busy.
+ ***********************************************************************
+ */
+
+
+#include <chrono>
+
+#include "bus_worker.hpp"
+#include "realtime.hpp"
+#include "../diagnostics/tracer.hpp"
+
+
+BusOperation BusWorker::dioPort(MCP23S17Controller::DIOPinInfo pin, uint8_t setMask, uint8_t clearMask) {
+    BusOperation op = {};
+    op.type = BUS_DIO_PORT;
+    op.pin = pin;
+    op.setMask = setMask;
+    op.clearMask = clearMask;
+    return op;
+};
+
+BusOperation BusWorker::dacCode(int dac, int dacOutput, uint8_t code) {
+    BusOperation op = {};
+    op.type = BUS_DAC_CODE;
+    op.dac = dac;
+    op.dacOutput = dacOutput;
+    op.code = code;
+    return op;
+};
+
+BusOperation BusWorker::adcRaw() {
+    BusOperation op = {};
+    op.type = BUS_ADC_RAW;
+    return op;
+};
+
+BusOperation BusWorker::wait(int waitUs) {
+    BusOperation op = {};
+    op.type = BUS_WAIT;
+    op.waitUs = waitUs;
+    return op;
+};
+
+BusWorker::BusWorker(FixtureBus& bus)
+    : bus(bus), queue(QUEUE_CAPACITY), running(false),
+      pool(QUEUE_CAPACITY), freeRequests(QUEUE_CAPACITY), submitters(0), active(false) {
+    for (Request& request : pool) {
+        freeRequests.push(&request);
+    }
+    bus.setBusOwner(this);
+};
+
+BusWorker::~BusWorker() {
+    stop();
+    bus.setBusOwner(nullptr);
+};
+
+int BusWorker::start() {
+    if (thread.joinable()) {
+        return -1;
+    }
+    realtime = false;
+    active.store(true);
+    running.store(true);
+    thread = std::thread(&BusWorker::loop, this);
+    return 0;
+};
+
+int BusWorker::startRealtime(int core, int priority, size_t stackBytes) {
+    if (thread.joinable()) {
+        return -1;
+    }
+    realtime = true;
+    realtimeCore = core;
+    realtimePriority = priority;
+    realtimeStackBytes = stackBytes;
+    active.store(true);
+    running.store(true);
+    thread = std::thread(&BusWorker::loop, this);
+    return 0;
+};
+
+void BusWorker::stop() {
+    if (!thread.joinable()) {
+        return;
+    }
+    running.store(false);
+
+    // Submitters which saw running before it was cleared finish pushing before the join.
+    while (submitters.load() > 0) {
+        std::this_thread::yield();
+    }
+    thread.join();
+
+    // The bus thread may have exited just before the last of those pushes, nothing would complete them.
+    Request* request;
+    while (queue.pop(request)) {
+        fail(request);
+    }
+    active.store(false);
+};
+
+std::future<BusResult> BusWorker::submit(const BusOperation& op) {
+    Request* request = acquire();
+    if (request == nullptr) {
+        std::promise<BusResult> failed;
+        failed.set_value({0, true});
+        return failed.get_future();
+    }
+    request->op = op;
+    request->single = std::promise<BusResult>();
+    std::future<BusResult> result = request->single.get_future();
+    enqueue(request);
+    return result;
+};
+
+int BusWorker::submit(const BusOperation& op, std::function<void(const BusResult&)> callback) {
+    Request* request = acquire();
+    if (request == nullptr) {
+        return -1;
+    }
+    request->op = op;
+    request->callback = std::move(callback);
+    enqueue(request);
+    return 0;
+};
+
+std::future<std::vector<BusResult>> BusWorker::submitBatch(std::vector<BusOperation> ops) {
+    Request* request = acquire();
+    if (request == nullptr) {
+        std::promise<std::vector<BusResult>> failed;
+        failed.set_value(std::vector<BusResult>(ops.size(), BusResult{0, true}));
+        return failed.get_future();
+    }
+    request->ops = std::move(ops);
+    request->isBatch = true;
+    request->batch = std::promise<std::vector<BusResult>>();
+    std::future<std::vector<BusResult>> result = request->batch.get_future();
+    enqueue(request);
+    return result;
+};
+
+std::future<int> BusWorker::submitJob(std::function<int()> job) {
+    Request* request = acquire();
+    if (request == nullptr) {
+        std::promise<int> failed;
+        failed.set_value(-1);
+        return failed.get_future();
+    }
+    request->job = std::move(job);
+    request->jobResult = std::promise<int>();
+    std::future<int> result = request->jobResult.get_future();
+    enqueue(request);
+    return result;
+};
+
+bool BusWorker::mayAccessBus() const {
+    return !active.load() || busThread.load() == std::this_thread::get_id();
+};
+
+int BusWorker::runOnBus(const std::function<int()>& work) {
+    Request* request = acquire();
+    if (request == nullptr) {
+        // Stopping, the bus is free once the bus thread has been joined.
+        while (active.load()) {
+            std::this_thread::yield();
+        }
+        return work();
+    }
+    request->job = work;
+    request->jobResult = std::promise<int>();
+    std::future<int> result = request->jobResult.get_future();
+    enqueue(request);
+    return result.get();
+};
+
+BusWorker::Request* BusWorker::acquire() {
+    submitters.fetch_add(1);
+    // Without a running bus thread nothing would ever complete the request.
+    if (!running.load()) {
+        submitters.fetch_sub(1);
+        return nullptr;
+    }
+    // No free request means the bus is behind, wait for it to catch up rather than drop the request.
+    Request* request;
+    while (!freeRequests.pop(request)) {
+        std::this_thread::yield();
+    }
+    return request;
+};
+
+void BusWorker::enqueue(Request* request) {
+    // There are never more requests than queue slots, so the push cannot fail.
+    queue.push(request);
+    submitters.fetch_sub(1);
+};
+
+void BusWorker::release(Request* request) {
+    request->ops.clear();
+    request->isBatch = false;
+    request->job = nullptr;
+    request->callback = nullptr;
+    freeRequests.push(request);
+};
+
+void BusWorker::fail(Request* request) {
+    BusResult failed = {0, true};
+    if (request->isBatch) {
+        request->batch.set_value(std::vector<BusResult>(request->ops.size(), failed));
+    } else if (request->job) {
+        request->jobResult.set_value(-1);
+    } else if (request->callback) {
+        request->callback(failed);
+    } else {
+        request->single.set_value(failed);
+    }
+    release(request);
+};
+
+void BusWorker::loop() {
+    Request* request;
+    int idlePolls = 0;
+
+    busThread.store(std::this_thread::get_id());
+
+    if (realtime) {
+        Realtime::configureThread("bus", realtimeCore, realtimePriority, realtimeStackBytes);
+    }
+
+    if (Tracer::enabled()) {
+        Tracer::nameThread("bus");
+    }
+
+    while (true) {
+        if (queue.pop(request)) {
+            process(request);
+            idlePolls = 0;
+            continue;
+        }
+
+        // Only exits once the queue is drained, so no future is left without a value.
+        if (!running.load(std::memory_order_acquire)) {
+            break;
+        }
+
+        // Spin for a short while so back to back requests are picked up quickly, then back off.
+        if (idlePolls < IDLE_SPIN_LIMIT) {
+            idlePolls++;
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(IDLE_SLEEP_US));
+        }
+    }
+};
+
+void BusWorker::process(Request* request) {
+    if (request->isBatch) {
+        std::vector<BusResult> results;
+        results.reserve(request->ops.size());
+        for (const BusOperation& op : request->ops) {
+            results.push_back(bus.execute(op));
+        }
+        request->batch.set_value(std::move(results));
+    } else if (request->job) {
+        request->jobResult.set_value(request->job());
+    } else {
+        BusResult result = bus.execute(request->op);
+        if (request->callback) {
+            request->callback(result);
+        } else {
+            request->single.set_value(result);
+        }
+    }
+    release(request);
+};
@@ -0,0 +1,181 @@
+/*
+ * bus_worker.hpp:
+ ***********************************************************************
+ * Bus-owner thread for the SPI bus.
+ *      All DIO, DAC and ADC operations are queued to a single thread which
+ *      is the only one allowed to touch the SPI bus and CS pins. Callers get
+ *      a future or callback back, so test logic can continue while the bus
+ *      is busy.
+ ***********************************************************************
+ */
+
+
+#include <atomic>
+#include <functional>
+#include <future>
+#include <thread>
+#include <vector>
+
+#include "lockfree_queue.hpp"
+#include "../ic_controllers/bus_owner.hpp"
+#include "../ic_controllers/fixture_bus.hpp"
+
+#ifndef BUSWORKER
+#define BUSWORKER
+
+class BusWorker : public BusOwner {
+    public:
+        /** Helpers to build bus operations. */
+        static BusOperation dioPort(MCP23S17Controller::DIOPinInfo pin, uint8_t setMask, uint8_t clearMask);
+        static BusOperation dacCode(int dac, int dacOutput, uint8_t code);
+        static BusOperation adcRaw();
+        static BusOperation wait(int waitUs);
+
+        /**
+         * Binds the worker to the fixture bus it will own once started.
+         * The bus is attached to the worker, so its methods called from other threads are
+         * serialized through the bus thread.
+         * @param bus the fixture's bus.
+         */
+        explicit BusWorker(FixtureBus& bus);
+
+        /** Stops the bus thread, finishing any queued operations first, and detaches the bus. */
+        ~BusWorker();
+
+        BusWorker(const BusWorker&) = delete;
+        BusWorker& operator=(const BusWorker&) = delete;
+
+        /**
+         * Starts the bus-owner thread. Drivers must already be initialized.
+         * @returns -1 if the thread is already running.
+         */
+        int start();
+
+        /**
+         * Starts the bus-owner thread as a real-time thread, see realtime.hpp.
+         * Drivers must already be initialized.
+         * @param core core the bus thread is pinned to.
+         * @param priority SCHED_FIFO priority of the bus thread, 1-99.
+         * @param stackBytes amount of stack prefaulted before the first operation.
+         * @returns -1 if the thread is already running.
+         */
+        int startRealtime(int core, int priority, size_t stackBytes);
+
+        /**
+         * Stops the bus-owner thread once all queued operations are complete.
+         * Requests submitted while stopping either run or complete as failed on the calling thread,
+         * callbacks included, none are left waiting.
+         */
+        void stop();
+
+        /**
+         * Queues a single operation.
+         * @param op the operation to execute.
+         * @returns a future holding the result, failed if the bus thread is not running.
+         */
+        std::future<BusResult> submit(const BusOperation& op);
+
+        /**
+         * Queues a single operation and runs a callback when complete.
+         * The callback runs on the bus thread and must be short, the bus is idle while it runs. A request
+         * that never runs because the worker is stopping is completed by the thread calling stop instead,
+         * with a failed result.
+         * @param op the operation to execute.
+         * @param callback called with the result of the operation.
+         * @returns -1 if the bus thread is not running.
+         */
+        int submit(const BusOperation& op, std::function<void(const BusResult&)> callback);
+
+        /**
+         * Queues several operations which are executed back to back without other requests in between.
+         * @param ops the operations to execute, in order.
+         * @returns a future holding the results of each operation in order, all failed if the bus thread is not running.
+         */
+        std::future<std::vector<BusResult>> submitBatch(std::vector<BusOperation> ops);
+
+        /**
+         * Queues a longer job, e.g. a whole test plan, which gets the bus to itself until it returns.
+         * The job may use the fixture bus directly since it runs on the bus thread.
+         * @param job the job to run.
+         * @returns a future holding the value returned by the job, -1 if the bus thread is not running.
+         */
+        std::future<int> submitJob(std::function<int()> job);
+
+        /** See bus_owner.hpp. */
+        bool mayAccessBus() const override;
+        int runOnBus(const std::function<int()>& work) override;
+
+    private:
+        /** Max number of requests waiting for the bus at once, also the number of preallocated requests. */
+        const int QUEUE_CAPACITY = 1024;
+
+        /** Number of empty polls spent spinning before the bus thread starts sleeping. */
+        const int IDLE_SPIN_LIMIT = 2000;
+
+        /** Sleep between polls once the bus thread is idle, in microseconds. */
+        const int IDLE_SLEEP_US = 20;
+
+        /**
+         * A queued request, either a single operation, a batch or a job.
+         * Requests are reused from a pool and a single operation is held in op, so a submit
+         * allocates at most the shared state of its future.
+         */
+        struct Request {
+            BusOperation op;
+            std::vector<BusOperation> ops;
+            bool isBatch = false;
+            std::function<int()> job;
+            std::promise<int> jobResult;
+            std::promise<BusResult> single;
+            std::promise<std::vector<BusResult>> batch;
+            std::function<void(const BusResult&)> callback;
+        };
+
+        FixtureBus& bus;
+
+        LockFreeQueue<Request*> queue;
+        std::thread thread;
+        std::atomic<bool> running;
+
+        /** Preallocated requests and the ones currently free. */
+        std::vector<Request> pool;
+        LockFreeQueue<Request*> freeRequests;
+
+        /** Number of threads between acquire and enqueue, stop waits for them before joining. */
+        std::atomic<int> submitters;
+
+        /** True from start until the bus thread has been joined. */
+        std::atomic<bool> active;
+
+        /** Id of the bus thread, set once it runs. */
+        std::atomic<std::thread::id> busThread;
+
+        /** Real-time settings applied by the bus thread when it starts. */
+        bool realtime = false;
+        int realtimeCore = 0;
+        int realtimePriority = 0;
+        size_t realtimeStackBytes = 0;
+
+        /** Main loop of the bus-owner thread. */
+        void loop();
+
+        /** Executes and completes a single request, only called from the bus thread. */
+        void process(Request* request);
+
+        /**
+         * Takes a free request, spinning while all are in use. Must be followed by enqueue.
+         * @returns nullptr if the bus thread is not running.
+         */
+        Request* acquire();
+
+        /** Pushes a request taken by acquire. */
+        void enqueue(Request* request);
+
+        /** Clears a completed request and returns it to the pool. */
+        void release(Request* request);
+
+        /** Completes a request that will never run with failed results, runs on the thread calling stop. */
+        void fail(Request* request);
+};
+
+#endif
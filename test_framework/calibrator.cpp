@@ -0,0 +1,228 @@
+/*
+ * calibrator.cpp:
+ ***********************************************************************
+ * DAC to ADC loopback self-calibration.
+ *      Sweeps every AD8802 output through every DAC input value, measures
+ *      it with the LTC2380 on a loopback fixture, fits gain/offset and
+ *      keeps the measured curve (INL) per output, then writes a
+ *      calibration file which CalibrationTable memory-maps at startup.
+ ***********************************************************************
+ */
+
+
+#include <unistd.h>
+#include <wiringPi.h>
+#include <cerrno>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include "calibrator.hpp"
+
+
+Calibrator::Calibrator(FixtureBus& boards, LTC2380Controller& adc)
+    : boards(boards), LTC2380(adc) {
+};
+
+int Calibrator::loadLoopback(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cout << "Could not open loopback file: " << path << "\n";
+        return -1;
+    }
+
+    std::vector<std::string> names;
+    std::vector<MCP23S17Controller::DIOPinInfo> pins;
+    std::vector<std::vector<MCP23S17Controller::DIOPinInfo>> routes(CALIBRATION_DACS * CALIBRATION_OUTPUTS);
+    std::vector<bool> routed(CALIBRATION_DACS * CALIBRATION_OUTPUTS, false);
+    std::vector<MCP23S17Controller::DIOPinInfo> routePins;
+    bool referenced = false;
+
+    // Keeps going after an error so every bad line is reported at once.
+    bool passed = true;
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        std::istringstream tokens(line.substr(0, line.find('#')));
+        std::string statement;
+        if (!(tokens >> statement)) {
+            continue;
+        }
+
+        if (statement == "PIN") {
+            std::string name;
+            MCP23S17Controller::DIOPinInfo pin;
+            if (!(tokens >> name >> pin.primaryExpander >> pin.primaryPin >> pin.secondaryExpander >> pin.secondaryPin)
+                    || pin.primaryExpander < 0 || pin.primaryExpander > 1 || pin.primaryPin < 0 || pin.primaryPin > 15
+                    || pin.secondaryExpander < 2 || pin.secondaryExpander > 33 || pin.secondaryPin < 0 || pin.secondaryPin > 15) {
+                std::cout << "Line " << lineNumber << ": invalid PIN statement.\n";
+                passed = false;
+                continue;
+            }
+            names.push_back(name);
+            pins.push_back(pin);
+        } else if (statement == "ROUTE") {
+            int dac, output;
+            if (!(tokens >> dac >> output) || dac < 1 || dac > CALIBRATION_DACS || output < 1 || output > CALIBRATION_OUTPUTS) {
+                std::cout << "Line " << lineNumber << ": invalid ROUTE statement.\n";
+                passed = false;
+                continue;
+            }
+            int index = (dac - 1) * CALIBRATION_OUTPUTS + output - 1;
+            routed[index] = true;
+            std::string name;
+            while (tokens >> name) {
+                size_t pin = 0;
+                while (pin < names.size() && names[pin] != name) {
+                    pin++;
+                }
+                if (pin == names.size()) {
+                    std::cout << "Line " << lineNumber << ": unknown pin " << name << ", pins must be declared with PIN first.\n";
+                    passed = false;
+                    continue;
+                }
+                routes[index].push_back(pins[pin]);
+                routePins.push_back(pins[pin]);
+            }
+        } else if (statement == "REFERENCE") {
+            int dac, output, code;
+            double volts;
+            if (!(tokens >> dac >> output >> code >> volts) || dac < 1 || dac > CALIBRATION_DACS
+                    || output < 1 || output > CALIBRATION_OUTPUTS || code < 0 || code >= CALIBRATION_CODES || volts <= 0) {
+                std::cout << "Line " << lineNumber << ": invalid REFERENCE statement.\n";
+                passed = false;
+                continue;
+            }
+            setReference(dac - 1, output - 1, code, volts);
+            referenced = true;
+        } else {
+            std::cout << "Line " << lineNumber << ": unknown statement " << statement << ".\n";
+            passed = false;
+        }
+    }
+
+    for (int index = 0; index < CALIBRATION_DACS * CALIBRATION_OUTPUTS; index++) {
+        if (!routed[index]) {
+            std::cout << "DAC " << index / CALIBRATION_OUTPUTS + 1 << " output " << index % CALIBRATION_OUTPUTS + 1
+                      << " has no ROUTE.\n";
+            passed = false;
+        }
+    }
+    if (!referenced) {
+        std::cout << "The loopback file has no REFERENCE, the ADC gain cannot be calibrated without one.\n";
+        passed = false;
+    }
+    if (!passed) {
+        hasReference = false;
+        return -1;
+    }
+
+    // Every route is opened before the next one is closed, so two outputs are never shorted together.
+    setRouting([this, routes, routePins](int dac, int dacOutput) {
+        for (const MCP23S17Controller::DIOPinInfo& pin : routePins) {
+            boards.disablePin(pin);
+        }
+        for (const MCP23S17Controller::DIOPinInfo& pin : routes[dac * CALIBRATION_OUTPUTS + dacOutput]) {
+            boards.enablePin(pin);
+        }
+    });
+    return 0;
+};
+
+void Calibrator::setRouting(std::function<void(int dac, int dacOutput)> routing) {
+    route = std::move(routing);
+};
+
+void Calibrator::setReference(int dac, int dacOutput, int code, double volts) {
+    hasReference = true;
+    referenceDac = dac;
+    referenceOutput = dacOutput;
+    referenceCode = code;
+    referenceVolts = volts;
+};
+
+int Calibrator::measure(int dac, int dacOutput, int code, double& average) {
+    if (boards.applyCode(dac, dacOutput, code) == -1) {
+        std::cout << "DAC " << dac + 1 << " output " << dacOutput + 1 << " could not be set to code " << code << ".\n";
+        return -1;
+    }
+    delayMicroseconds(SETTLE_US);
+
+    double total = 0;
+    int samples = 0;
+    for (int i = 0; i < SAMPLES_PER_POINT; i++) {
+        int raw;
+        if (boards.readRaw(raw) == -1) {
+            continue;
+        }
+        total += raw;
+        samples++;
+    }
+    if (samples == 0) {
+        std::cout << "Every ADC read failed for DAC " << dac + 1 << " output " << dacOutput + 1 << " code " << code << ".\n";
+        return -1;
+    }
+    average = total / samples;
+    return 0;
+};
+
+int Calibrator::run(const std::string& path, bool overwrite) {
+    if (!route || !hasReference) {
+        std::cout << "Calibration needs the loopback routing and a reference point, see calibrator.hpp.\n";
+        return -1;
+    }
+    // Checked before the sweep too, so a long sweep is not lost to a file that was never going to be replaced.
+    if (!overwrite && access(path.c_str(), F_OK) == 0) {
+        std::cout << "Calibration file " << path << " already exists, pass --overwrite to replace it.\n";
+        return -1;
+    }
+
+    // Stage 1: ADC gain, from the reference point.
+    route(referenceDac, referenceOutput);
+    double average;
+    if (measure(referenceDac, referenceOutput, referenceCode, average) == -1) {
+        return -1;
+    }
+    double reading = LTC2380.rawToVolts(average);
+    if (reading <= 0) {
+        std::cout << "The reference point read " << reading << " V, check the loopback routing.\n";
+        return -1;
+    }
+    double adcGain = referenceVolts / reading;
+    std::cout << "ADC voltage gain correction: " << adcGain << "\n";
+
+    // Stage 2: sweep every DAC output through every input value.
+    std::vector<ChannelCalibration> channels(CALIBRATION_DACS * CALIBRATION_OUTPUTS);
+    for (int dac = 0; dac < CALIBRATION_DACS; dac++) {
+        for (int dacOutput = 0; dacOutput < CALIBRATION_OUTPUTS; dacOutput++) {
+            ChannelCalibration& channel = channels[dac * CALIBRATION_OUTPUTS + dacOutput];
+            route(dac, dacOutput);
+
+            for (int code = 0; code < CALIBRATION_CODES; code++) {
+                if (measure(dac, dacOutput, code, average) == -1) {
+                    return -1;
+                }
+                channel.measured[code] = LTC2380.rawToVolts(average) * adcGain;
+            }
+            boards.applyCode(dac, dacOutput, 0);
+
+            double maxInl = CalibrationTable::fit(channel, AD8802Controller::MAX_VOLTAGE);
+            std::cout << "DAC " << dac + 1 << " output " << dacOutput + 1 << ": gain " << channel.gain
+                      << " V/code, offset " << channel.offset << " V, max INL " << maxInl << " V.\n";
+        }
+    }
+
+    // Stage 3: persist.
+    if (CalibrationTable::write(path, adcGain, channels.data(), AD8802Controller::MAX_VOLTAGE, overwrite) == -1) {
+        if (errno == EEXIST) {
+            std::cout << "Calibration file " << path << " already exists, pass --overwrite to replace it.\n";
+            return -1;
+        }
+        std::cout << "Calibration file " << path << " could not be written.\n";
+        return -1;
+    }
+    std::cout << "Calibration written to " << path << ".\n";
+    return 0;
+};
@@ -0,0 +1,100 @@
+/*
+ * calibrator.hpp:
+ ***********************************************************************
+ * DAC to ADC loopback self-calibration.
+ *      Sweeps every AD8802 output through every DAC input value, measures
+ *      it with the LTC2380 on a loopback fixture, fits gain/offset and
+ *      keeps the measured curve (INL) per output, then writes a
+ *      calibration file which CalibrationTable memory-maps at startup.
+ *
+ * Loopback file format, one statement per line, # starts a comment:
+ *      PIN <name> <primaryExpander> <primaryPin> <secondaryExpander> <secondaryPin>
+ *      ROUTE <dac 1-2> <output 1-12> [pin name...]      DIO pins connecting the output to the ADC input,
+ *                                                      none if it is wired straight to the ADC
+ *      REFERENCE <dac 1-2> <output 1-12> <code 0-255> <volts>
+ *                                                      a point measured with a reference meter
+ *      Every output needs a ROUTE and the file needs one REFERENCE.
+ ***********************************************************************
+ */
+
+
+#include <functional>
+#include <string>
+
+#include "../ic_controllers/fixture_bus.hpp"
+#include "../ic_controllers/AD8802.hpp"
+#include "../ic_controllers/LTC2380.hpp"
+#include "../ic_controllers/calibration_table.hpp"
+
+#ifndef CALIBRATOR
+#define CALIBRATOR
+
+class Calibrator {
+    private:
+        FixtureBus& boards;
+        LTC2380Controller& LTC2380;
+
+        /** Time the DAC output is given to settle before it is measured, in microseconds. */
+        const int SETTLE_US = 100;
+
+        /** Number of ADC readings averaged for every point. */
+        const int SAMPLES_PER_POINT = 4;
+
+        /** Connects a DAC output to the ADC input, e.g. by switching relays on the loopback fixture. */
+        std::function<void(int dac, int dacOutput)> route;
+
+        /** An externally measured point used to correct the ADC gain. */
+        bool hasReference = false;
+        int referenceDac = 0;
+        int referenceOutput = 0;
+        int referenceCode = 0;
+        double referenceVolts = 0;
+
+        /**
+         * Applies a DAC input value and measures the result, failed ADC reads are left out of the average.
+         * @param average set to the averaged raw ADC conversion result.
+         * @returns -1 if the DAC could not be set or every ADC read failed.
+         */
+        int measure(int dac, int dacOutput, int code, double& average);
+
+    public:
+        /**
+         * @param boards the loopback fixture's bus, its DIO pins switch the loopback routing.
+         * @param adc the LTC2380 controller, converts the readings to volts.
+         */
+        Calibrator(FixtureBus& boards, LTC2380Controller& adc);
+
+        /**
+         * Sets the routing and the reference point from a loopback file, see the format above.
+         * @param path the loopback file.
+         * @returns -1 if the file could not be read, has errors or misses an output or the reference.
+         */
+        int loadLoopback(const std::string& path);
+
+        /**
+         * Sets how each DAC output is connected to the ADC input.
+         * @param routing called before each output is swept.
+         */
+        void setRouting(std::function<void(int dac, int dacOutput)> routing);
+
+        /**
+         * Sets a point measured with a reference meter, used to correct the ADC gain.
+         * @param dac the DAC, 0 or 1.
+         * @param dacOutput the DAC output channel, 0-11.
+         * @param code the DAC input value.
+         * @param volts the voltage measured with the reference meter.
+         */
+        void setReference(int dac, int dacOutput, int code, double volts);
+
+        /**
+         * Runs the full sweep and writes the calibration file. Uses the bus directly.
+         * Refuses to run until both the routing and the reference point are set.
+         * @param path the calibration file.
+         * @param overwrite replace an existing calibration file, otherwise one is never replaced.
+         * @returns -1 if the routing or reference is missing, the ADC could not be read
+         *     or the calibration file exists or could not be written.
+         */
+        int run(const std::string& path, bool overwrite = false);
+};
+
+#endif
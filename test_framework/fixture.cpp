@@ -0,0 +1,72 @@
+/*
+ * fixture.cpp:
+ ***********************************************************************
+ * A single test fixture.
+ *      Groups one SPI bus with the MCP23S17, AD8802 and LTC2380 boards
+ *      wired to it, so several fixtures can be driven from one RPi.
+ ***********************************************************************
+ */
+
+
+#include <iostream>
+
+#include "fixture.hpp"
+
+
+SPIDriver Fixture::makeSPIDriver(const FixtureConfig& config) {
+    const int chipSelects[SPIDriver::CHIP_SELECT_COUNT] = {
+        config.primaryExpanderCs[0],
+        config.primaryExpanderCs[1],
+        config.dacCs[0],
+        config.dacCs[1],
+        config.adcCs
+    };
+    return SPIDriver(config.spiBus, config.spiChannel, chipSelects);
+};
+
+Fixture::Fixture(GPIODriver& gpio, const FixtureConfig& config)
+    : config(config),
+      gpio(gpio),
+      spi(makeSPIDriver(config)),
+      MCP23S17(config.primaryExpanderCs[0], config.primaryExpanderCs[1]),
+      AD8802(config.dacCs[0], config.dacCs[1]),
+      LTC2380(config.adcCs, config.adcCnv),
+      boards(spi, gpio, MCP23S17, AD8802, LTC2380),
+      bus(boards) {
+};
+
+int Fixture::init() {
+    if (spi.initSPI() == -1) {
+        std::cout << "SPI bus " << config.spiBus << "." << config.spiChannel << " setup failed.\n";
+        return -1;
+    }
+
+    if (boards.initMCP23S17() == -1) {
+        std::cout << "MCP23S17 Board setup failed on SPI bus " << config.spiBus << ".\n";
+        return -1;
+    }
+
+    if (boards.initAD8802() == -1) {
+        std::cout << "AD8802 Board setup failed on SPI bus " << config.spiBus << ".\n";
+        return -1;
+    }
+
+    if (boards.initLTC2380() == -1) {
+        std::cout << "LTC2380 Board setup failed on SPI bus " << config.spiBus << ".\n";
+        return -1;
+    }
+
+    if (!config.calibrationPath.empty()) {
+        if (calibration.load(config.calibrationPath) == -1) {
+            std::cout << "Calibration " << config.calibrationPath << " failed to load on SPI bus " << config.spiBus << ".\n";
+            return -1;
+        }
+        LTC2380.setVoltageGain(calibration.adcVoltageGain());
+    }
+
+    return 0;
+};
+
+uint64_t Fixture::calibrationId() const {
+    return calibration.loaded() ? calibration.created() : 0;
+};
@@ -0,0 +1,91 @@
+/*
+ * fixture.hpp:
+ ***********************************************************************
+ * A single test fixture.
+ *      Groups one SPI bus with the MCP23S17, AD8802 and LTC2380 boards
+ *      wired to it, so several fixtures can be driven from one RPi.
+ ***********************************************************************
+ */
+
+
+#include <string>
+
+#include "bus_worker.hpp"
+#include "../ic_controllers/fixture_bus.hpp"
+#include "../ic_controllers/calibration_table.hpp"
+#include "../hardware_drivers/spi.hpp"
+#include "../hardware_drivers/gpio.hpp"
+#include "../ic_controllers/MCP23S17.hpp"
+#include "../ic_controllers/AD8802.hpp"
+#include "../ic_controllers/LTC2380.hpp"
+
+#ifndef FIXTURE
+#define FIXTURE
+
+/**
+ * Struct containing the wiring of a fixture, the defaults are the original single fixture wiring.
+ * @param spiBus the SPI bus number, the x in /dev/spidevx.y.
+ * @param spiChannel the SPI channel on the bus, the y in /dev/spidevx.y.
+ * @param primaryExpanderCs chip selects of the two primary expanders.
+ * @param dacCs chip selects of the two DACs.
+ * @param adcCs the SDI pin of the ADC used as a CS.
+ * @param adcCnv the conversion start pin of the ADC.
+ * @param calibrationPath the calibration file of this fixture's boards, empty to use the ideal DAC and hand-tuned ADC values.
+ */
+struct FixtureConfig {
+    int spiBus = 0;
+    int spiChannel = 0;
+    int primaryExpanderCs[2] = {21, 22};
+    int dacCs[2] = {23, 24};
+    int adcCs = 25;
+    int adcCnv = 29;
+    std::string calibrationPath;
+};
+
+class Fixture {
+    private:
+        /** Builds the CS list handed to the SPI driver. */
+        static SPIDriver makeSPIDriver(const FixtureConfig& config);
+
+    public:
+        /** The wiring this fixture was created with. */
+        const FixtureConfig config;
+
+        /** GPIO is shared by every fixture, each fixture only touches its own pins. */
+        GPIODriver& gpio;
+
+        SPIDriver spi;
+        MCP23S17Controller MCP23S17;
+        AD8802Controller AD8802;
+        LTC2380Controller LTC2380;
+
+        /** Bus access through the controllers above, the wiring is only known at runtime. */
+        ControllerBus boards;
+
+        /** Bus-owner thread for this fixture's bus, not started by default. */
+        BusWorker bus;
+
+        /** Calibration of this fixture's boards, loaded by init if the config names one. */
+        CalibrationTable calibration;
+
+        /**
+         * Creates the drivers and controllers for a fixture, nothing is initialized yet.
+         * @param gpio a GPIO driver, already initialized.
+         * @param config the wiring of the fixture.
+         */
+        Fixture(GPIODriver& gpio, const FixtureConfig& config);
+
+        Fixture(const Fixture&) = delete;
+        Fixture& operator=(const Fixture&) = delete;
+
+        /**
+         * Initializes the SPI bus and all boards of this fixture and loads its calibration.
+         * @returns -1 if initialization failed or the calibration failed to load.
+         */
+        int init();
+
+        /** @returns the id of the loaded calibration, 0 if none is loaded. */
+        uint64_t calibrationId() const;
+};
+
+#endif
@@ -0,0 +1,192 @@
+/*
+ * fixture_scheduler.cpp:
+ ***********************************************************************
+ * Runs test sessions on several fixtures at once.
+ *      Each fixture has its own SPI bus, so one session thread per fixture
+ *      can run without any locking. Session threads are pinned to their own
+ *      core, leaving core 0 to the OS and the main thread.
+ ***********************************************************************
+ */
+
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <utility>
+
+#include "fixture_scheduler.hpp"
+#include "realtime.hpp"
+
+
+FixtureScheduler::FixtureScheduler(GPIODriver& gpio) : gpio(gpio) {
+};
+
+int FixtureScheduler::addFixture(const FixtureConfig& config) {
+    if (validate(config) == -1) {
+        return -1;
+    }
+    fixtures.push_back(std::unique_ptr<Fixture>(new Fixture(gpio, config)));
+    return fixtures.size() - 1;
+};
+
+int FixtureScheduler::loadFixtures(const char* path) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        std::cout << "Fixture file " << path << " could not be opened.\n";
+        return -1;
+    }
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        std::istringstream fields(line);
+        std::string first;
+        if (!(fields >> first) || first[0] == '#') {
+            continue;
+        }
+
+        FixtureConfig config;
+        std::istringstream values(line);
+        if (!(values >> config.spiBus >> config.spiChannel >> config.primaryExpanderCs[0] >> config.primaryExpanderCs[1]
+                     >> config.dacCs[0] >> config.dacCs[1] >> config.adcCs >> config.adcCnv)) {
+            std::cout << "Fixture file line " << lineNumber << " needs 8 numbers.\n";
+            return -1;
+        }
+        std::string extra;
+        if (values >> config.calibrationPath && values >> extra) {
+            std::cout << "Fixture file line " << lineNumber << " has more than 8 numbers and a calibration file.\n";
+            return -1;
+        }
+        if (addFixture(config) == -1) {
+            std::cout << "Fixture file line " << lineNumber << " rejected.\n";
+            return -1;
+        }
+    }
+    return 0;
+};
+
+std::vector<int> FixtureScheduler::reservedPins() {
+    std::vector<int> pins;
+    for (const std::unique_ptr<Fixture>& fixture : fixtures) {
+        if (fixture->config.spiBus == 0) {
+            continue;
+        }
+        std::vector<int> busPins = SPIDriver::busPins(fixture->config.spiBus);
+        pins.insert(pins.end(), busPins.begin(), busPins.end());
+    }
+    return pins;
+};
+
+Fixture& FixtureScheduler::fixture(int index) {
+    return *fixtures[index];
+};
+
+int FixtureScheduler::fixtureCount() {
+    return fixtures.size();
+};
+
+int FixtureScheduler::initFixtures() {
+    bool passed = true;
+    for (size_t i = 0; i < fixtures.size(); i++) {
+        if (fixtures[i]->init() == -1) {
+            std::cout << "Fixture " << i << " setup failed.\n";
+            passed = false;
+        } else {
+            std::cout << "Fixture " << i << " setup successful.\n";
+        }
+    }
+    return passed ? 0 : -1;
+};
+
+std::vector<int> FixtureScheduler::run(Session session) {
+    std::vector<int> results(fixtures.size(), -1);
+    std::vector<std::thread> threads;
+
+    for (size_t i = 0; i < fixtures.size(); i++) {
+        threads.emplace_back([this, i, &session, &results]() {
+            if (Realtime::pinThread(coreFor(i)) == -1) {
+                std::cout << "Fixture " << i << " could not be pinned to a core, running unpinned.\n";
+            }
+            results[i] = session(*fixtures[i]);
+        });
+    }
+
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    return results;
+};
+
+int FixtureScheduler::validate(const FixtureConfig& config) {
+    if (config.spiBus < 0 || config.spiBus > SPIDriver::MAX_BUS || SPIDriver::busPins(config.spiBus).empty()) {
+        std::cout << "SPI bus " << config.spiBus << " is not available.\n";
+        return -1;
+    }
+
+    // Every bus that will be in use, and every CS and CNV pin with the bus of its fixture.
+    std::vector<int> buses;
+    std::vector<std::pair<int, int>> pins;
+    auto addPins = [&pins](const FixtureConfig& wiring) {
+        const int fixturePins[6] = {wiring.primaryExpanderCs[0], wiring.primaryExpanderCs[1], wiring.dacCs[0],
+                                    wiring.dacCs[1], wiring.adcCs, wiring.adcCnv};
+        for (int pin : fixturePins) {
+            pins.push_back({pin, wiring.spiBus});
+        }
+    };
+    for (const std::unique_ptr<Fixture>& fixture : fixtures) {
+        // Channels of one bus share SCLK and MOSI, so two fixtures on one bus could not run in parallel.
+        if (fixture->config.spiBus == config.spiBus) {
+            std::cout << "SPI bus " << config.spiBus << " is already used by another fixture.\n";
+            return -1;
+        }
+        buses.push_back(fixture->config.spiBus);
+        addPins(fixture->config);
+    }
+    buses.push_back(config.spiBus);
+    size_t newPins = pins.size();
+    addPins(config);
+
+    // initGPIO only sets up the output pins, a CS or CNV anywhere else would never be driven.
+    for (size_t i = newPins; i < pins.size(); i++) {
+        if (!GPIODriver::isOutputPin(pins[i].first)) {
+            std::cout << "Pin " << pins[i].first << " of the fixture on SPI bus " << config.spiBus
+                      << " is not a GPIO output pin.\n";
+            return -1;
+        }
+    }
+
+    for (size_t i = newPins; i < pins.size(); i++) {
+        for (size_t j = 0; j < i; j++) {
+            if (pins[i].first == pins[j].first) {
+                std::cout << "Pin " << pins[i].first << " is used twice, by fixtures on SPI buses "
+                          << pins[j].second << " and " << pins[i].second << ".\n";
+                return -1;
+            }
+        }
+    }
+
+    // A new bus can also take over pins of the fixtures already added, so every pin is checked.
+    for (const std::pair<int, int>& pin : pins) {
+        for (int bus : buses) {
+            std::vector<int> busPins = SPIDriver::busPins(bus);
+            if (std::find(busPins.begin(), busPins.end(), pin.first) != busPins.end()) {
+                std::cout << "Pin " << pin.first << " of the fixture on SPI bus " << pin.second
+                          << " is a pin of SPI bus " << bus << ".\n";
+                return -1;
+            }
+        }
+    }
+    return 0;
+};
+
+int FixtureScheduler::coreFor(int index) {
+    int cores = std::thread::hardware_concurrency();
+    if (cores <= 1) {
+        return 0;
+    }
+    // Core 0 is skipped, once every other core has a fixture they start being shared.
+    return 1 + index % (cores - 1);
+};
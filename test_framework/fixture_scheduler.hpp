@@ -0,0 +1,96 @@
+/*
+ * fixture_scheduler.hpp:
+ ***********************************************************************
+ * Runs test sessions on several fixtures at once.
+ *      Each fixture has its own SPI bus, so one session thread per fixture
+ *      can run without any locking. Session threads are pinned to their own
+ *      core, leaving core 0 to the OS and the main thread.
+ ***********************************************************************
+ */
+
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "fixture.hpp"
+#include "../hardware_drivers/gpio.hpp"
+
+#ifndef FIXTURESCHEDULER
+#define FIXTURESCHEDULER
+
+class FixtureScheduler {
+    private:
+        GPIODriver& gpio;
+        std::vector<std::unique_ptr<Fixture>> fixtures;
+
+        /**
+         * Checks a fixture's wiring against itself and the fixtures already added.
+         * Buses must be distinct since channels of one bus share SCLK and MOSI, CS and CNV pins must be
+         * distinct GPIO output pins, and no CS or CNV pin may be a pin of any SPI bus in use.
+         * @param config the wiring of the new fixture.
+         * @returns -1 if the wiring conflicts, the reason is printed.
+         */
+        int validate(const FixtureConfig& config);
+
+        /**
+         * Picks the core a fixture's session runs on.
+         * @param index index of the fixture.
+         * @returns the core number.
+         */
+        int coreFor(int index);
+
+    public:
+        /** A test session, gets exclusive use of one fixture and returns -1 if the test failed. */
+        typedef std::function<int(Fixture&)> Session;
+
+        /**
+         * @param gpio a GPIO driver shared by every fixture, initialized with reservedPins() once every fixture is added.
+         */
+        explicit FixtureScheduler(GPIODriver& gpio);
+
+        /**
+         * Adds a fixture, each fixture must use a different SPI bus and its own CS pins, see validate.
+         * @param config the wiring of the fixture.
+         * @returns the index of the fixture, -1 if its wiring conflicts.
+         */
+        int addFixture(const FixtureConfig& config);
+
+        /**
+         * Adds every fixture listed in a text file, one per line as
+         *     spiBus spiChannel primary1Cs primary2Cs dac1Cs dac2Cs adcCs adcCnv [calibration.bin]
+         * with wiringPi pin numbers and optionally the fixture's calibration file.
+         * Blank lines and lines starting with # are skipped.
+         * @param path the fixture file.
+         * @returns -1 if the file could not be read or a fixture was rejected.
+         */
+        int loadFixtures(const char* path);
+
+        /** @returns the pins of every SPI bus in use other than bus 0, which GPIO initialization must leave alone. */
+        std::vector<int> reservedPins();
+
+        /**
+         * @param index index of the fixture.
+         * @returns the fixture.
+         */
+        Fixture& fixture(int index);
+
+        /** @returns the number of fixtures. */
+        int fixtureCount();
+
+        /**
+         * Initializes every fixture.
+         * @returns -1 if any fixture failed to initialize.
+         */
+        int initFixtures();
+
+        /**
+         * Runs the session on every fixture in parallel, one pinned thread per fixture.
+         * Blocks until every session is complete.
+         * @param session the test session to run.
+         * @returns the result of the session for each fixture, in fixture order.
+         */
+        std::vector<int> run(Session session);
+};
+
+#endif
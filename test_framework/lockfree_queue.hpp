@@ -0,0 +1,117 @@
+/*
+ * lockfree_queue.hpp:
+ ***********************************************************************
+ * Bounded lock-free queue used to hand work between threads.
+ *      Based on Dmitry Vyukov's bounded MPMC queue, each slot carries a
+ *      sequence number so producers and consumers never take a lock.
+ ***********************************************************************
+ */
+
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#ifndef LOCKFREEQUEUE
+#define LOCKFREEQUEUE
+
+template <typename T>
+class LockFreeQueue {
+    private:
+        /** A single queue entry, the sequence tells whose turn it is to use the slot. */
+        struct Slot {
+            std::atomic<size_t> sequence;
+            T value;
+        };
+
+        /** Storage for the queue, size is always a power of 2. */
+        std::vector<Slot> slots;
+
+        /** Mask used in place of a modulo when wrapping positions. */
+        const size_t mask;
+
+        /** Positions are kept on separate cache lines to avoid false sharing. */
+        alignas(64) std::atomic<size_t> enqueuePos;
+        alignas(64) std::atomic<size_t> dequeuePos;
+
+        /** Rounds a requested capacity up to the next power of 2. */
+        static size_t roundCapacity(size_t capacity) {
+            size_t rounded = 2;
+            while (rounded < capacity) {
+                rounded <<= 1;
+            }
+            return rounded;
+        }
+
+    public:
+        /**
+         * Creates a queue able to hold at least the given number of items.
+         * @param capacity minimum number of items the queue can hold.
+         */
+        explicit LockFreeQueue(size_t capacity)
+            : slots(roundCapacity(capacity)), mask(roundCapacity(capacity) - 1), enqueuePos(0), dequeuePos(0) {
+            for (size_t i = 0; i < slots.size(); i++) {
+                slots[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        LockFreeQueue(const LockFreeQueue&) = delete;
+        LockFreeQueue& operator=(const LockFreeQueue&) = delete;
+
+        /**
+         * Adds an item to the queue. Safe to call from any number of threads.
+         * @param value the item being added.
+         * @returns false if the queue is full.
+         */
+        bool push(const T& value) {
+            size_t pos = enqueuePos.load(std::memory_order_relaxed);
+            Slot* slot;
+            while (true) {
+                slot = &slots[pos & mask];
+                size_t sequence = slot->sequence.load(std::memory_order_acquire);
+                intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+                if (diff == 0) {
+                    if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        break;
+                    }
+                } else if (diff < 0) {
+                    return false;
+                } else {
+                    pos = enqueuePos.load(std::memory_order_relaxed);
+                }
+            }
+            slot->value = value;
+            slot->sequence.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * Removes the oldest item from the queue. Safe to call from any number of threads.
+         * @param value filled with the removed item.
+         * @returns false if the queue is empty.
+         */
+        bool pop(T& value) {
+            size_t pos = dequeuePos.load(std::memory_order_relaxed);
+            Slot* slot;
+            while (true) {
+                slot = &slots[pos & mask];
+                size_t sequence = slot->sequence.load(std::memory_order_acquire);
+                intptr_t diff = (intptr_t)sequence - (intptr_t)(pos + 1);
+                if (diff == 0) {
+                    if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        break;
+                    }
+                } else if (diff < 0) {
+                    return false;
+                } else {
+                    pos = dequeuePos.load(std::memory_order_relaxed);
+                }
+            }
+            value = slot->value;
+            slot->sequence.store(pos + mask + 1, std::memory_order_release);
+            return true;
+        }
+};
+
+#endif
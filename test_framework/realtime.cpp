@@ -0,0 +1,75 @@
+/*
+ * realtime.cpp:
+ ***********************************************************************
+ * Real-time execution helpers.
+ *      Locks memory, pins threads to cores, switches them to SCHED_FIFO
+ *      and prefaults their stacks, so ADC sampling and DAC timing are not
+ *      disturbed by page faults or the normal scheduler. Works best with
+ *      the chosen cores kept free of other tasks, e.g. isolcpus=2,3 on
+ *      the kernel command line.
+ ***********************************************************************
+ */
+
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <alloca.h>
+#include <cstring>
+#include <iostream>
+
+#include "realtime.hpp"
+
+
+int Realtime::lockMemory() {
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        return -1;
+    }
+    return 0;
+};
+
+int Realtime::pinThread(int core) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(core, &cpus);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0) {
+        return -1;
+    }
+    return 0;
+};
+
+int Realtime::setFifo(int priority) {
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = priority;
+    if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) != 0) {
+        return -1;
+    }
+    return 0;
+};
+
+void Realtime::prefaultStack(size_t bytes) {
+    // Writing the memory forces every page to be mapped, volatile stops the compiler skipping it.
+    volatile unsigned char* stack = (volatile unsigned char*)alloca(bytes);
+    for (size_t i = 0; i < bytes; i += 4096) {
+        stack[i] = 0;
+    }
+};
+
+int Realtime::configureThread(const char* name, int core, int priority, size_t stackBytes) {
+    bool passed = true;
+
+    if (pinThread(core) == -1) {
+        std::cout << "Could not pin " << name << " thread to core " << core << ".\n";
+        passed = false;
+    }
+
+    if (setFifo(priority) == -1) {
+        std::cout << "Could not set " << name << " thread to SCHED_FIFO priority " << priority << ".\n";
+        passed = false;
+    }
+
+    prefaultStack(stackBytes);
+
+    return passed ? 0 : -1;
+};
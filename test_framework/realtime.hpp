@@ -0,0 +1,74 @@
+/*
+ * realtime.hpp:
+ ***********************************************************************
+ * Real-time execution helpers.
+ *      Locks memory, pins threads to cores, switches them to SCHED_FIFO
+ *      and prefaults their stacks, so ADC sampling and DAC timing are not
+ *      disturbed by page faults or the normal scheduler. Works best with
+ *      the chosen cores kept free of other tasks, e.g. isolcpus=2,3 on
+ *      the kernel command line.
+ ***********************************************************************
+ */
+
+
+#include <cstddef>
+
+#ifndef REALTIME
+#define REALTIME
+
+/**
+ * Struct containing the real-time settings of a test run.
+ * @param mainCore core the test logic thread is pinned to.
+ * @param mainPriority SCHED_FIFO priority of the test logic thread, 1-99.
+ * @param busCore core the bus-owner thread is pinned to.
+ * @param busPriority SCHED_FIFO priority of the bus-owner thread, 1-99.
+ * @param stackBytes amount of stack prefaulted on each real-time thread.
+ */
+struct RealtimeConfig {
+    int mainCore = 2;
+    int mainPriority = 70;
+    int busCore = 3;
+    int busPriority = 80;
+    size_t stackBytes = 256 * 1024;
+};
+
+class Realtime {
+    public:
+        /**
+         * Locks all current and future memory of the process into RAM.
+         * @returns -1 if locking failed, usually missing CAP_IPC_LOCK or a low memlock limit.
+         */
+        static int lockMemory();
+
+        /**
+         * Pins the calling thread to a single core.
+         * @param core the core number.
+         * @returns -1 if pinning failed.
+         */
+        static int pinThread(int core);
+
+        /**
+         * Switches the calling thread to the SCHED_FIFO scheduler.
+         * @param priority the SCHED_FIFO priority, 1-99.
+         * @returns -1 if the scheduler could not be changed, usually missing CAP_SYS_NICE.
+         */
+        static int setFifo(int priority);
+
+        /**
+         * Touches the given amount of stack so it is already mapped before time critical code runs.
+         * @param bytes amount of stack to touch.
+         */
+        static void prefaultStack(size_t bytes);
+
+        /**
+         * Pins, prioritizes and prefaults the calling thread, printing any step that failed.
+         * @param name the thread name used in messages.
+         * @param core the core number.
+         * @param priority the SCHED_FIFO priority, 1-99.
+         * @param stackBytes amount of stack to touch.
+         * @returns -1 if any step failed.
+         */
+        static int configureThread(const char* name, int core, int priority, size_t stackBytes);
+};
+
+#endif
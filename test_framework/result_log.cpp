@@ -0,0 +1,156 @@
+/*
+ * result_log.cpp:
+ ***********************************************************************
+ * Binary measurement and event log.
+ *      Fixed size records are written straight into a preallocated,
+ *      memory-mapped ring file, so logging from the test loop costs a
+ *      few stores with no syscalls or string formatting. Logs are turned
+ *      into CSV or columnar files offline with tools/log_exporter.
+ ***********************************************************************
+ */
+
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+#include "result_log.hpp"
+
+
+ResultLog::~ResultLog() {
+    close();
+};
+
+int ResultLog::open(const std::string& path, uint32_t capacity, bool overwrite) {
+    close();
+
+    // The rounded capacity is stored in the 32-bit header field.
+    if (capacity > MAX_CAPACITY) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    uint64_t rounded = 2;
+    while (rounded < capacity) {
+        rounded <<= 1;
+    }
+    size_t size = sizeof(LogHeader) + rounded * sizeof(LogRecord);
+
+    // Logs of earlier runs are only replaced when asked to, a mistyped argument must not destroy one.
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | (overwrite ? O_TRUNC : O_EXCL), 0644);
+    if (fd < 0) {
+        return -1;
+    }
+
+    // Allocates the disk blocks now, otherwise the first write to each page would have to.
+    if (posix_fallocate(fd, 0, size) != 0) {
+        ::close(fd);
+        return -1;
+    }
+
+    // MAP_POPULATE faults every page in now rather than during the test.
+    void* mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        return -1;
+    }
+
+    mapping = mapped;
+    mappingSize = size;
+    header = (LogHeader*)mapped;
+    records = (LogRecord*)(header + 1);
+    mask = rounded - 1;
+    written = 0;
+
+    memset(header, 0, sizeof(LogHeader));
+    header->magic = RESULT_LOG_MAGIC;
+    header->version = RESULT_LOG_VERSION;
+    header->recordSize = sizeof(LogRecord);
+    header->capacity = rounded;
+    return 0;
+};
+
+void ResultLog::close() {
+    if (mapping != nullptr) {
+        msync(mapping, mappingSize, MS_SYNC);
+        munmap(mapping, mappingSize);
+    }
+    mapping = nullptr;
+    mappingSize = 0;
+    header = nullptr;
+    records = nullptr;
+    mask = 0;
+    written = 0;
+};
+
+bool ResultLog::isOpen() const {
+    return mapping != nullptr;
+};
+
+ResultLogReader::~ResultLogReader() {
+    unload();
+};
+
+int ResultLogReader::load(const std::string& path) {
+    unload();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) < 0 || (size_t)info.st_size < sizeof(LogHeader)) {
+        ::close(fd);
+        return -1;
+    }
+
+    void* mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        return -1;
+    }
+
+    const LogHeader* mappedHeader = (const LogHeader*)mapped;
+    // The ring index is record number & (capacity - 1), which only works for a nonzero power of 2.
+    uint32_t capacity = mappedHeader->capacity;
+    if (mappedHeader->magic != RESULT_LOG_MAGIC
+            || mappedHeader->version != RESULT_LOG_VERSION
+            || mappedHeader->recordSize != sizeof(LogRecord)
+            || capacity == 0 || (capacity & (capacity - 1)) != 0
+            || sizeof(LogHeader) + (size_t)mappedHeader->capacity * sizeof(LogRecord) > (size_t)info.st_size) {
+        munmap(mapped, info.st_size);
+        return -1;
+    }
+
+    mapping = mapped;
+    mappingSize = info.st_size;
+    header = mappedHeader;
+    records = (const LogRecord*)(mappedHeader + 1);
+    mask = mappedHeader->capacity - 1;
+
+    // Once the ring has wrapped only the newest capacity records are still in the file.
+    last = mappedHeader->written;
+    first = last > mappedHeader->capacity ? last - mappedHeader->capacity : 0;
+    return 0;
+};
+
+void ResultLogReader::unload() {
+    if (mapping != nullptr) {
+        munmap(mapping, mappingSize);
+    }
+    mapping = nullptr;
+    mappingSize = 0;
+    header = nullptr;
+    records = nullptr;
+    mask = 0;
+    first = 0;
+    last = 0;
+};
+
+uint64_t ResultLogReader::count() const {
+    return last - first;
+};
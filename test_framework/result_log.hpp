@@ -0,0 +1,204 @@
+/*
+ * result_log.hpp:
+ ***********************************************************************
+ * Binary measurement and event log.
+ *      Fixed size records are written straight into a preallocated,
+ *      memory-mapped ring file, so logging from the test loop costs a
+ *      few stores with no syscalls or string formatting. Logs are turned
+ *      into CSV or columnar files offline with tools/log_exporter.
+ ***********************************************************************
+ */
+
+
+#include <cstdint>
+#include <ctime>
+#include <string>
+
+#ifndef RESULTLOG
+#define RESULTLOG
+
+/** Identifies a result log file, "ICRL". */
+#define RESULT_LOG_MAGIC 0x4C524349
+#define RESULT_LOG_VERSION 2
+
+/** Bits of LogRecord::status. */
+#define LOG_STATUS_READ_FAILED 0x01
+#define LOG_STATUS_WRITE_FAILED 0x02
+
+/** List of all logged events. */
+typedef enum {
+    LOG_ADC,
+    LOG_DIO,
+    LOG_DAC,
+    LOG_STEP
+} LogEvent;
+
+/**
+ * Header at the start of every result log file, padded to a cache line.
+ * @param magic always RESULT_LOG_MAGIC.
+ * @param version format version, RESULT_LOG_VERSION.
+ * @param recordSize size of a single record, sizeof(LogRecord).
+ * @param capacity number of records the ring holds, a power of 2.
+ * @param written total number of records ever written, the ring wraps once this passes capacity.
+ */
+struct LogHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t recordSize;
+    uint32_t capacity;
+    uint64_t written;
+    uint8_t reserved[40];
+};
+
+/**
+ * A single 32 byte log record.
+ * @param timestamp CLOCK_MONOTONIC time in nanoseconds.
+ * @param sequence low 32 bits of the record number, used to spot gaps.
+ * @param step the test step the record belongs to.
+ * @param event one of LogEvent.
+ * @param channel ADC: 1 for voltage, 0 for current. DIO: secondary expander. DAC: DAC*12 + output.
+ *     STEP records mark the start of a step and only use the timestamp and step.
+ * @param passed 1 if the measurement was within limits. Other events: 1 unless their SPI transfer failed.
+ * @param status LOG_STATUS_ bits. ADC: LOG_STATUS_READ_FAILED if the SPI transfer failed, raw and value are then -1.
+ *     DIO and DAC: LOG_STATUS_WRITE_FAILED if the SPI transfer failed.
+ * @param raw ADC: raw conversion result. DIO: pin on the secondary expander. DAC: DAC input value.
+ * @param value ADC: scaled value. DIO: 1 for on, 0 for off. DAC: unused.
+ */
+struct LogRecord {
+    uint64_t timestamp;
+    uint32_t sequence;
+    uint32_t step;
+    uint8_t event;
+    uint8_t channel;
+    uint8_t passed;
+    uint8_t status;
+    int32_t raw;
+    double value;
+};
+
+class ResultLog {
+    private:
+        /** The mapped file, header followed by the records. */
+        void* mapping = nullptr;
+        size_t mappingSize = 0;
+
+        LogHeader* header = nullptr;
+        LogRecord* records = nullptr;
+        uint64_t mask = 0;
+
+        /** Local copy of header->written, the writer is the only one changing it. */
+        uint64_t written = 0;
+
+    public:
+        /** Largest capacity open accepts, the header stores the capacity in 32 bits. */
+        static const uint32_t MAX_CAPACITY = 1u << 31;
+
+        ResultLog() = default;
+        ~ResultLog();
+
+        ResultLog(const ResultLog&) = delete;
+        ResultLog& operator=(const ResultLog&) = delete;
+
+        /**
+         * Creates a new log file, preallocates it and maps it into memory.
+         * @param path the log file.
+         * @param capacity number of records kept before the oldest are overwritten, rounded up to a power of 2, at most MAX_CAPACITY.
+         * @param overwrite true to replace an existing file, otherwise an existing file is left alone.
+         * @returns -1 if capacity is above MAX_CAPACITY (errno is then EINVAL), the file exists and overwrite is
+         *     false (errno is then EEXIST), or could not be created or mapped.
+         */
+        int open(const std::string& path, uint32_t capacity, bool overwrite = false);
+
+        /** Flushes and unmaps the log, if one is open. */
+        void close();
+
+        /** @returns true if a log is open. */
+        bool isOpen() const;
+
+        /**
+         * Appends a record. Only one thread may write to a log.
+         * Kept in the header so the test loop can inline it.
+         * @param step the test step.
+         * @param event one of LogEvent.
+         * @param channel see LogRecord.
+         * @param raw see LogRecord.
+         * @param value see LogRecord.
+         * @param passed whether the measurement was within limits.
+         * @param status see LogRecord.
+         */
+        inline void record(uint32_t step, uint8_t event, uint8_t channel, int32_t raw, double value, bool passed,
+                           uint8_t status = 0) {
+            // clock_gettime on CLOCK_MONOTONIC is served by the vDSO, it does not enter the kernel.
+            struct timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            recordAt((uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec, step, event, channel, raw, value, passed, status);
+        }
+
+        /**
+         * Appends a record of something that happened earlier, e.g. on the bus thread. Only one thread may write to a log.
+         * @param timestamp CLOCK_MONOTONIC time in nanoseconds it happened.
+         * See record for the other parameters.
+         */
+        inline void recordAt(uint64_t timestamp, uint32_t step, uint8_t event, uint8_t channel, int32_t raw, double value,
+                             bool passed, uint8_t status = 0) {
+            LogRecord& entry = records[written & mask];
+            entry.timestamp = timestamp;
+            entry.sequence = (uint32_t)written;
+            entry.step = step;
+            entry.event = event;
+            entry.channel = channel;
+            entry.passed = passed ? 1 : 0;
+            entry.status = status;
+            entry.raw = raw;
+            entry.value = value;
+
+            written++;
+            __atomic_store_n(&header->written, written, __ATOMIC_RELEASE);
+        }
+};
+
+class ResultLogReader {
+    private:
+        /** The mapped file, header followed by the records. */
+        void* mapping = nullptr;
+        size_t mappingSize = 0;
+
+        const LogHeader* header = nullptr;
+        const LogRecord* records = nullptr;
+        uint64_t mask = 0;
+
+        /** Record numbers of the oldest record still in the ring and one past the newest. */
+        uint64_t first = 0;
+        uint64_t last = 0;
+
+    public:
+        ResultLogReader() = default;
+        ~ResultLogReader();
+
+        ResultLogReader(const ResultLogReader&) = delete;
+        ResultLogReader& operator=(const ResultLogReader&) = delete;
+
+        /**
+         * Memory-maps an existing result log read-only and validates its header.
+         * Only RESULT_LOG_VERSION logs are read, older logs lack the status bits.
+         * @param path the log file.
+         * @returns -1 if the file could not be mapped or is not a valid result log.
+         */
+        int load(const std::string& path);
+
+        /** Unmaps the log, if one is loaded. */
+        void unload();
+
+        /** @returns the number of records still in the ring. */
+        uint64_t count() const;
+
+        /**
+         * @param index 0 for the oldest record still in the ring.
+         * @returns the record.
+         */
+        const LogRecord& record(uint64_t index) const {
+            return records[(first + index) & mask];
+        }
+};
+
+#endif
\ No newline at end of file
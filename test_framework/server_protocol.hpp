@@ -0,0 +1,136 @@
+/*
+ * server_protocol.hpp:
+ ***********************************************************************
+ * Binary protocol of the test server (./test --serve <socket>).
+ *      Clients connect to a Unix domain stream socket. Every message is a
+ *      MessageHeader followed by a payload whose size follows from the
+ *      type and count, all fields little-endian as on the RPi.
+ *
+ * Client to server:
+ *      SERVER_BATCH         count PlanInstructions, executed in order as one unit.
+ *                           DIO, DIO_PORT, DAC, ADC and WAIT are allowed, fields as
+ *                           in test_plan.hpp, DAC values are DAC input values.
+ *                           The bus time BusCostModel predicts for the batch, WAITs
+ *                           included, may not exceed SERVER_MAX_BATCH_US, split
+ *                           longer sequences into several batches.
+ *                           tag is echoed back in the result.
+ *      SERVER_SUBSCRIBE     one ADC PlanInstruction, tag is the period in microseconds.
+ *                           Rejected if the client's subscriptions would take more
+ *                           than the server's sample budget of bus time, the
+ *                           predicted read time over the period summed up.
+ *                           A sample is late by at most one batch of any client,
+ *                           SERVER_MAX_BATCH_US.
+ *      SERVER_UNSUBSCRIBE   no payload, tag is the subscription id.
+ *
+ * Server to client:
+ *      SERVER_BATCH_RESULT  count BatchResults, one per instruction, tag of the batch.
+ *      SERVER_SUBSCRIBED    no payload, tag is the new subscription id.
+ *      SERVER_SAMPLE        one Sample, tag is the subscription id.
+ *      SERVER_ERROR         no payload, tag of the rejected message. The connection
+ *                           is closed after an error, since the stream can no longer be trusted.
+ *
+ * A client may shut down its sending side after its last request, every request
+ * already sent is still answered before the server closes the connection.
+ ***********************************************************************
+ */
+
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "test_plan.hpp"
+
+#ifndef SERVERPROTOCOL
+#define SERVERPROTOCOL
+
+/** Largest number of instructions in a single batch. */
+#define SERVER_MAX_BATCH 1024
+
+/** Longest predicted bus time of a single batch, other clients and every subscription wait while a batch runs. */
+#define SERVER_MAX_BATCH_US 20000
+
+/** List of all message types. */
+typedef enum {
+    SERVER_BATCH,
+    SERVER_SUBSCRIBE,
+    SERVER_UNSUBSCRIBE,
+    SERVER_BATCH_RESULT,
+    SERVER_SUBSCRIBED,
+    SERVER_SAMPLE,
+    SERVER_ERROR
+} MessageType;
+
+/**
+ * Header at the start of every message.
+ * @param type one of MessageType.
+ * @param count number of payload entries, see the message types.
+ * @param tag depends on the message type.
+ */
+struct MessageHeader {
+    uint16_t type;
+    uint16_t count;
+    uint32_t tag;
+};
+
+/**
+ * Result of a single batched instruction.
+ * @param value ADC: the scaled value. Other instructions: 0.
+ * @param passed ADC: 1 if the value was within the instruction's limits. Other instructions: 1.
+ */
+struct BatchResult {
+    int32_t value;
+    uint32_t passed;
+};
+
+/**
+ * A single streamed ADC sample.
+ * @param timestamp CLOCK_MONOTONIC time of the read in nanoseconds.
+ * @param value the scaled value.
+ * @param passed 1 if the value was within the subscription's limits.
+ */
+struct Sample {
+    uint64_t timestamp;
+    int32_t value;
+    uint32_t passed;
+};
+
+/**
+ * Frames the next message of a client's stream.
+ * @param data the received bytes, starting at a message header, they need no alignment.
+ * @param available number of received bytes.
+ * @returns the size of the message if it is complete, 0 if more bytes are needed, -1 if it is invalid.
+ */
+inline int messageSize(const uint8_t* data, size_t available) {
+    if (available < sizeof(MessageHeader)) {
+        return 0;
+    }
+
+    // Copied out, a stream buffer gives no alignment guarantee for the header.
+    MessageHeader header;
+    memcpy(&header, data, sizeof(header));
+    size_t size;
+    switch (header.type) {
+        case SERVER_BATCH:
+            if (header.count == 0 || header.count > SERVER_MAX_BATCH) {
+                return -1;
+            }
+            size = sizeof(MessageHeader) + header.count * sizeof(PlanInstruction);
+            break;
+        case SERVER_SUBSCRIBE:
+            if (header.count != 1) {
+                return -1;
+            }
+            size = sizeof(MessageHeader) + sizeof(PlanInstruction);
+            break;
+        case SERVER_UNSUBSCRIBE:
+            size = sizeof(MessageHeader);
+            break;
+        default:
+            return -1;
+    }
+
+    return available >= size ? size : 0;
+}
+
+#endif
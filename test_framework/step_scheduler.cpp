@@ -0,0 +1,108 @@
+/*
+ * step_scheduler.cpp:
+ ***********************************************************************
+ * Test step scheduler.
+ *      Coalesces consecutive pin changes on the same secondary expander
+ *      port into one read-modify-write.
+ ***********************************************************************
+ */
+
+
+#include "step_scheduler.hpp"
+
+
+/** Pin changes on one secondary expander port, applied with a single read-modify-write. */
+struct PortUpdate {
+    PlanInstruction first;
+    uint8_t setMask;
+    uint8_t clearMask;
+    int pinCount;
+};
+
+std::vector<PlanInstruction> StepScheduler::schedule(const std::vector<PlanInstruction>& instructions,
+                                                     const std::vector<size_t>& syncPoints) {
+    std::vector<PlanInstruction> scheduled;
+    scheduled.reserve(instructions.size());
+
+    size_t groupStart = 0;
+    size_t nextSync = 0;
+    for (size_t i = 0; i <= instructions.size(); i++) {
+        // DIO and DAC statements never move across each other, the device under test may depend on their order.
+        bool barrier = i == instructions.size()
+                    || instructions[i].opcode == PLAN_ADC || instructions[i].opcode == PLAN_WAIT
+                    || (i > groupStart && instructions[i].step != instructions[groupStart].step)
+                    || (i > groupStart && (instructions[i].opcode == PLAN_DAC) != (instructions[groupStart].opcode == PLAN_DAC));
+        while (nextSync < syncPoints.size() && syncPoints[nextSync] < i) {
+            nextSync++;
+        }
+        if (nextSync < syncPoints.size() && syncPoints[nextSync] == i) {
+            barrier = true;
+        }
+        if (!barrier) {
+            continue;
+        }
+
+        scheduleGroup(instructions.data() + groupStart, i - groupStart, scheduled);
+        if (i == instructions.size()) {
+            break;
+        }
+        if (instructions[i].opcode == PLAN_ADC || instructions[i].opcode == PLAN_WAIT) {
+            scheduled.push_back(instructions[i]);
+            groupStart = i + 1;
+        } else {
+            groupStart = i;
+        }
+    }
+
+    return scheduled;
+};
+
+void StepScheduler::scheduleGroup(const PlanInstruction* group, size_t count, std::vector<PlanInstruction>& scheduled) {
+    // Every DAC write selects and deselects its DAC, so there is nothing to gain from touching them.
+    if (count == 0 || group[0].opcode == PLAN_DAC) {
+        scheduled.insert(scheduled.end(), group, group + count);
+        return;
+    }
+
+    // Changes are only merged while they hit the same port, so the coalesced plan makes every change in recipe order.
+    PortUpdate pending = {};
+    int pendingKey = -1;
+
+    for (size_t i = 0; i <= count; i++) {
+        int key = -1;
+        uint8_t pinMask = 0;
+        if (i < count) {
+            int port = group[i].value < 8 ? 0 : 1;
+            key = group[i].device << 8 | group[i].channel << 1 | port;
+            pinMask = 0b00000001 << (group[i].value % 8);
+        }
+
+        // A change on another port, or a second change to a pin already in the update, starts a new update.
+        if (pendingKey != -1 && (key != pendingKey || ((pending.setMask | pending.clearMask) & pinMask))) {
+            if (pending.pinCount == 1) {
+                scheduled.push_back(pending.first);
+            } else {
+                PlanInstruction coalesced = pending.first;
+                coalesced.opcode = PLAN_DIO_PORT;
+                coalesced.value = (pendingKey & 1) * 8;
+                coalesced.high = pending.setMask | pending.clearMask << 8;
+                scheduled.push_back(coalesced);
+            }
+            pendingKey = -1;
+        }
+        if (i == count) {
+            break;
+        }
+
+        if (pendingKey == -1) {
+            pending = {group[i], 0, 0, 0};
+            pendingKey = key;
+        }
+        if (group[i].opcode == PLAN_DIO_ON) {
+            pending.setMask |= pinMask;
+        } else {
+            pending.clearMask |= pinMask;
+        }
+        pending.pinCount++;
+    }
+};
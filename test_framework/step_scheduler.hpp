@@ -0,0 +1,52 @@
+/*
+ * step_scheduler.hpp:
+ ***********************************************************************
+ * Test step scheduler.
+ *      Coalesces consecutive pin changes on the same secondary expander
+ *      port into one read-modify-write. Every DIO operation costs four
+ *      primary expander CS sequences whatever ran before it, since every
+ *      controller call deselects its chip, so the saving comes from doing
+ *      fewer operations, not from their order.
+ *
+ * Dependencies:
+ *      Nothing is reordered. A change on a different port, a second change
+ *      to a pin already in the update, ADC reads, WAITs, DAC statements,
+ *      step boundaries and SYNC statements all end the update, so the only
+ *      difference from the recipe is fewer frames: pins changed together
+ *      in one update switch at the same time instead of one by one.
+ ***********************************************************************
+ */
+
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "test_plan.hpp"
+
+#ifndef STEPSCHEDULER
+#define STEPSCHEDULER
+
+class StepScheduler {
+    private:
+        /**
+         * Coalesces runs of consecutive changes to one port in a group of DIO instructions with no barrier
+         * between them, DAC groups are kept as they are.
+         * @param group the first instruction of the group.
+         * @param count number of instructions in the group.
+         * @param scheduled where the scheduled instructions are appended.
+         */
+        static void scheduleGroup(const PlanInstruction* group, size_t count, std::vector<PlanInstruction>& scheduled);
+
+    public:
+        /**
+         * Schedules a whole compiled recipe.
+         * @param instructions the instructions in recipe order.
+         * @param syncPoints indexes of instructions which must not move before any instruction ahead of them.
+         * @returns the scheduled instructions.
+         */
+        static std::vector<PlanInstruction> schedule(const std::vector<PlanInstruction>& instructions,
+                                                     const std::vector<size_t>& syncPoints);
+};
+
+#endif
@@ -0,0 +1,301 @@
+/*
+ * test_plan.cpp:
+ ***********************************************************************
+ * Compiled test plans.
+ *      A text recipe is compiled ahead of time into a flat binary stream of
+ *      fixed size instructions, with DIO pins already resolved and DAC
+ *      voltages already converted to DAC input values. The runner
+ *      memory-maps the file and steps through it without any parsing.
+ ***********************************************************************
+ */
+
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "test_plan.hpp"
+#include "step_scheduler.hpp"
+#include "../ic_controllers/dac_transfer.hpp"
+
+
+TestPlan::~TestPlan() {
+    unload();
+};
+
+int TestPlan::load(const std::string& path) {
+    unload();
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) < 0 || (size_t)info.st_size < sizeof(PlanHeader)) {
+        close(fd);
+        return -1;
+    }
+
+    // MAP_POPULATE faults the whole plan in now, so the runner never page faults mid test.
+    void* mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        return -1;
+    }
+
+    const PlanHeader* mappedHeader = (const PlanHeader*)mapped;
+    size_t expectedSize = sizeof(PlanHeader) + (size_t)mappedHeader->instructionCount * sizeof(PlanInstruction);
+    if (mappedHeader->magic != TEST_PLAN_MAGIC || mappedHeader->version != TEST_PLAN_VERSION
+            || expectedSize != (size_t)info.st_size) {
+        munmap(mapped, info.st_size);
+        return -1;
+    }
+
+    // Checked once here so the runner never has to.
+    const PlanInstruction* mappedInstructions = (const PlanInstruction*)(mappedHeader + 1);
+    for (uint32_t i = 0; i < mappedHeader->instructionCount; i++) {
+        if (!validInstruction(mappedInstructions[i]) || mappedInstructions[i].step >= mappedHeader->stepCount) {
+            std::cout << "Test plan instruction " << i << " is invalid.\n";
+            munmap(mapped, info.st_size);
+            return -1;
+        }
+    }
+
+    mapping = mapped;
+    mappingSize = info.st_size;
+    header = mappedHeader;
+    instructionList = (const PlanInstruction*)(mappedHeader + 1);
+    return 0;
+};
+
+bool TestPlan::validInstruction(const PlanInstruction& instruction) {
+    switch (instruction.opcode) {
+        case PLAN_DIO_ON:
+        case PLAN_DIO_OFF:
+            return instruction.device < 2 && instruction.channel < 16 && instruction.value < 16
+                && instruction.low >= PLAN_MIN_SECONDARY_EXPANDER && instruction.low <= PLAN_MAX_SECONDARY_EXPANDER;
+        case PLAN_DIO_PORT:
+            return instruction.device < 2 && instruction.channel < 16 && (instruction.value == 0 || instruction.value == 8)
+                && instruction.low >= PLAN_MIN_SECONDARY_EXPANDER && instruction.low <= PLAN_MAX_SECONDARY_EXPANDER
+                && (instruction.high & ~0xFFFF) == 0;
+        case PLAN_DAC:
+            return instruction.device < 2 && instruction.channel < 12;
+        case PLAN_ADC:
+            return instruction.device < 2;
+        case PLAN_WAIT:
+            return instruction.low >= 0;
+    }
+    return false;
+};
+
+void TestPlan::unload() {
+    if (mapping != nullptr) {
+        munmap(mapping, mappingSize);
+    }
+    mapping = nullptr;
+    mappingSize = 0;
+    header = nullptr;
+    instructionList = nullptr;
+};
+
+bool TestPlan::loaded() const {
+    return header != nullptr;
+};
+
+const PlanInstruction* TestPlan::instructions() const {
+    return instructionList;
+};
+
+uint32_t TestPlan::instructionCount() const {
+    return header == nullptr ? 0 : header->instructionCount;
+};
+
+uint32_t TestPlan::stepCount() const {
+    return header == nullptr ? 0 : header->stepCount;
+};
+
+uint64_t TestPlan::calibration() const {
+    return header == nullptr ? 0 : header->calibration;
+};
+
+void TestPlanCompiler::setCalibration(const CalibrationTable* table) {
+    calibration = table;
+};
+
+void TestPlanCompiler::setScheduling(bool enabled) {
+    scheduling = enabled;
+};
+
+const std::vector<PlanInstruction>& TestPlanCompiler::compiledInstructions() const {
+    return instructions;
+};
+
+const std::vector<PlanInstruction>& TestPlanCompiler::recipeInstructions() const {
+    return scheduling ? recipeOrder : instructions;
+};
+
+int TestPlanCompiler::compile(const std::string& recipePath) {
+    std::ifstream recipe(recipePath);
+    if (!recipe) {
+        std::cout << "Could not open recipe: " << recipePath << "\n";
+        return -1;
+    }
+
+    pins.clear();
+    instructions.clear();
+    syncPoints.clear();
+    recipeOrder.clear();
+    stepCount = 0;
+
+    // Keeps going after an error so every bad line is reported at once.
+    bool passed = true;
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(recipe, line)) {
+        lineNumber++;
+        if (compileLine(line, lineNumber) == -1) {
+            passed = false;
+        }
+    }
+
+    if (passed && scheduling) {
+        recipeOrder = instructions;
+        instructions = StepScheduler::schedule(recipeOrder, syncPoints);
+    }
+
+    return passed ? 0 : -1;
+};
+
+int TestPlanCompiler::compileLine(const std::string& line, int lineNumber) {
+    std::istringstream tokens(line.substr(0, line.find('#')));
+    std::string statement;
+    if (!(tokens >> statement)) {
+        return 0;
+    }
+
+    PlanInstruction instruction = {};
+    instruction.step = stepCount - 1;
+
+    if (statement == "PIN") {
+        PinAlias pin;
+        if (!(tokens >> pin.name >> pin.primaryExpander >> pin.primaryPin >> pin.secondaryExpander >> pin.secondaryPin)
+                || pin.primaryExpander < 0 || pin.primaryExpander > 1
+                || pin.primaryPin < 0 || pin.primaryPin > 15
+                || pin.secondaryExpander < PLAN_MIN_SECONDARY_EXPANDER || pin.secondaryExpander > PLAN_MAX_SECONDARY_EXPANDER
+                || pin.secondaryPin < 0 || pin.secondaryPin > 15) {
+            std::cout << "Line " << lineNumber << ": invalid PIN statement.\n";
+            return -1;
+        }
+        pins.push_back(pin);
+        return 0;
+    }
+
+    if (statement == "STEP") {
+        // The step name is only there to make the recipe readable.
+        stepCount++;
+        return 0;
+    }
+
+    if (statement == "SYNC") {
+        syncPoints.push_back(instructions.size());
+        return 0;
+    }
+
+    if (stepCount == 0) {
+        std::cout << "Line " << lineNumber << ": " << statement << " used before the first STEP.\n";
+        return -1;
+    }
+
+    if (statement == "DIO") {
+        std::string name, state;
+        tokens >> name >> state;
+        const PinAlias* pin = nullptr;
+        for (const PinAlias& alias : pins) {
+            if (alias.name == name) {
+                pin = &alias;
+            }
+        }
+        if (pin == nullptr || (state != "ON" && state != "OFF")) {
+            std::cout << "Line " << lineNumber << ": invalid DIO statement, pins must be declared with PIN first.\n";
+            return -1;
+        }
+        instruction.opcode = state == "ON" ? PLAN_DIO_ON : PLAN_DIO_OFF;
+        instruction.device = pin->primaryExpander;
+        instruction.channel = pin->primaryPin;
+        instruction.value = pin->secondaryPin;
+        instruction.low = pin->secondaryExpander;
+    } else if (statement == "DAC") {
+        int dac, output;
+        double voltage;
+        if (!(tokens >> dac >> output >> voltage) || dac < 1 || dac > 2 || output < 1 || output > 12
+                || voltage < 0.0 || voltage > 5.0) {
+            std::cout << "Line " << lineNumber << ": invalid DAC statement.\n";
+            return -1;
+        }
+        instruction.opcode = PLAN_DAC;
+        instruction.device = dac - 1;
+        instruction.channel = output - 1;
+        if (calibration != nullptr) {
+            instruction.value = calibration->code(dac - 1, output - 1, voltage);
+        } else {
+            instruction.value = idealDacCode(voltage);
+        }
+    } else if (statement == "ADC") {
+        std::string type;
+        double low, high;
+        if (!(tokens >> type >> low >> high) || (type != "VOLTAGE" && type != "CURRENT") || low > high) {
+            std::cout << "Line " << lineNumber << ": invalid ADC statement.\n";
+            return -1;
+        }
+        // The widened limits must still fit the instruction's 32-bit limit fields.
+        if (!std::isfinite(low) || !std::isfinite(high) || std::floor(low) < INT32_MIN || std::ceil(high) > INT32_MAX) {
+            std::cout << "Line " << lineNumber << ": ADC limits must be finite and within "
+                      << INT32_MIN << " to " << INT32_MAX << " scaled ADC units.\n";
+            return -1;
+        }
+        instruction.opcode = PLAN_ADC;
+        instruction.device = type == "VOLTAGE" ? 1 : 0;
+        // Limits are widened to whole ADC units so a reading on the limit still passes.
+        instruction.low = (int32_t)std::floor(low);
+        instruction.high = (int32_t)std::ceil(high);
+    } else if (statement == "WAIT") {
+        int microseconds;
+        if (!(tokens >> microseconds) || microseconds < 0) {
+            std::cout << "Line " << lineNumber << ": invalid WAIT statement.\n";
+            return -1;
+        }
+        instruction.opcode = PLAN_WAIT;
+        instruction.low = microseconds;
+    } else {
+        std::cout << "Line " << lineNumber << ": unknown statement " << statement << ".\n";
+        return -1;
+    }
+
+    instructions.push_back(instruction);
+    return 0;
+};
+
+int TestPlanCompiler::write(const std::string& planPath) {
+    std::ofstream plan(planPath, std::ios::binary | std::ios::trunc);
+    if (!plan) {
+        return -1;
+    }
+
+    PlanHeader header;
+    header.magic = TEST_PLAN_MAGIC;
+    header.version = TEST_PLAN_VERSION;
+    header.instructionCount = instructions.size();
+    header.stepCount = stepCount;
+    header.calibration = calibration != nullptr ? calibration->created() : 0;
+
+    plan.write((const char*)&header, sizeof(header));
+    plan.write((const char*)instructions.data(), instructions.size() * sizeof(PlanInstruction));
+    return plan ? 0 : -1;
+};
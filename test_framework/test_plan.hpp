@@ -0,0 +1,213 @@
+/*
+ * test_plan.hpp:
+ ***********************************************************************
+ * Compiled test plans.
+ *      A text recipe is compiled ahead of time into a flat binary stream of
+ *      fixed size instructions, with DIO pins already resolved and DAC
+ *      voltages already converted to DAC input values. The runner
+ *      memory-maps the file and steps through it without any parsing.
+ *
+ * Recipe format, one statement per line, # starts a comment:
+ *      PIN <name> <primaryExpander> <primaryPin> <secondaryExpander> <secondaryPin>
+ *      STEP [name]                                 starts the next test step
+ *      DIO <pin name> ON|OFF
+ *      DAC <dac 1-2> <output 1-12> <voltage>
+ *      ADC VOLTAGE|CURRENT <low limit> <high limit>   limits in scaled ADC units, see below
+ *      WAIT <microseconds>
+ *      SYNC                                        keeps the step scheduler from merging changes across this point
+ *
+ * ADC limits are compared with LTC2380Controller::scale, not volts or amps: raw x 20 x the voltage gain for
+ * VOLTAGE, raw / 7.995 x 10 for CURRENT. Limits are widened to whole units and must fit in 32 bits.
+ *
+ * With scheduling on, consecutive pin changes on the same secondary expander port are merged into one
+ * read-modify-write. Nothing is reordered, the plan only sends fewer frames; a SYNC keeps two changes apart.
+ ***********************************************************************
+ */
+
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../ic_controllers/calibration_table.hpp"
+
+#ifndef TESTPLAN
+#define TESTPLAN
+
+/** Identifies a compiled test plan file, "ICTP". */
+#define TEST_PLAN_MAGIC 0x50544349
+#define TEST_PLAN_VERSION 3
+
+/** Secondary expanders are numbered 2-33, see MCP23S17Controller::DIOPinInfo. */
+#define PLAN_MIN_SECONDARY_EXPANDER 2
+#define PLAN_MAX_SECONDARY_EXPANDER 33
+
+/** List of all test plan instructions. */
+typedef enum {
+    PLAN_DIO_ON,
+    PLAN_DIO_OFF,
+    PLAN_DAC,
+    PLAN_ADC,
+    PLAN_WAIT,
+    PLAN_DIO_PORT
+} PlanOpcode;
+
+/**
+ * Header at the start of every compiled test plan file.
+ * @param magic always TEST_PLAN_MAGIC.
+ * @param version format version, TEST_PLAN_VERSION.
+ * @param instructionCount number of instructions following the header.
+ * @param stepCount number of test steps in the plan.
+ * @param calibration CalibrationTable::created of the calibration the DAC values were compiled with, 0 for the
+ *     ideal transfer function. DAC values are baked into the plan, a calibration loaded at run time does not change them.
+ */
+struct PlanHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t instructionCount;
+    uint32_t stepCount;
+    uint64_t calibration;
+};
+
+/**
+ * A single 16 byte compiled instruction, fields are used depending on the opcode.
+ * @param opcode one of PlanOpcode.
+ * @param device DIO: primary expander. DAC: DAC 0-1. ADC: 1 for voltage, 0 for current.
+ * @param channel DIO: pin on the primary expander. DAC: output 0-11.
+ * @param value DIO: pin on the secondary expander, DIO_PORT: 0 for port A, 8 for port B. DAC: the DAC input value.
+ * @param step the step the instruction belongs to.
+ * @param low DIO: secondary expander. ADC: low limit. WAIT: microseconds.
+ * @param high ADC: high limit. DIO_PORT: pins to enable in bits 0-7, pins to disable in bits 8-15.
+ */
+struct PlanInstruction {
+    uint8_t opcode;
+    uint8_t device;
+    uint8_t channel;
+    uint8_t value;
+    uint32_t step;
+    int32_t low;
+    int32_t high;
+};
+
+class TestPlan {
+    private:
+        /** The mapped file, header followed by the instructions. */
+        void* mapping = nullptr;
+        size_t mappingSize = 0;
+
+        const PlanHeader* header = nullptr;
+        const PlanInstruction* instructionList = nullptr;
+
+    public:
+        TestPlan() = default;
+        ~TestPlan();
+
+        TestPlan(const TestPlan&) = delete;
+        TestPlan& operator=(const TestPlan&) = delete;
+
+        /**
+         * Memory-maps a compiled test plan file and validates its header and every instruction.
+         * @param path the compiled test plan file.
+         * @returns -1 if the file could not be mapped or is not a valid test plan.
+         */
+        int load(const std::string& path);
+
+        /**
+         * Checks the fields an instruction's opcode uses are in range for the fixture.
+         * The runner indexes the controllers' CS and address tables with them unchecked, so every
+         * instruction from a file or a client must pass this first.
+         * @param instruction the instruction.
+         * @returns false if the instruction is unknown or out of range.
+         */
+        static bool validInstruction(const PlanInstruction& instruction);
+
+        /** Unmaps the test plan, if one is loaded. */
+        void unload();
+
+        /** @returns true if a test plan is loaded. */
+        bool loaded() const;
+
+        /** @returns the instructions of the plan. */
+        const PlanInstruction* instructions() const;
+
+        /** @returns the number of instructions in the plan. */
+        uint32_t instructionCount() const;
+
+        /** @returns the number of test steps in the plan. */
+        uint32_t stepCount() const;
+
+        /** @returns the calibration the plan's DAC values were compiled with, 0 for the ideal transfer function. */
+        uint64_t calibration() const;
+};
+
+class TestPlanCompiler {
+    private:
+        /** A named DIO pin declared by a PIN statement. */
+        struct PinAlias {
+            std::string name;
+            int primaryExpander;
+            int primaryPin;
+            int secondaryExpander;
+            int secondaryPin;
+        };
+
+        std::vector<PinAlias> pins;
+        std::vector<PlanInstruction> instructions;
+        uint32_t stepCount = 0;
+
+        /** Coalesces pin changes within each run of DIO statements, see step_scheduler.hpp. */
+        bool scheduling = false;
+
+        /** Indexes of the instructions following a SYNC statement. */
+        std::vector<size_t> syncPoints;
+
+        /** Instructions in recipe order, kept to compare against the scheduled plan. */
+        std::vector<PlanInstruction> recipeOrder;
+
+        /** Measured DAC transfer functions, nullptr to assume the ideal transfer function. */
+        const CalibrationTable* calibration = nullptr;
+
+        /**
+         * Compiles a single line of a recipe.
+         * @param line the line, without the newline.
+         * @param lineNumber used in error messages.
+         * @returns -1 if the line is invalid.
+         */
+        int compileLine(const std::string& line, int lineNumber);
+
+    public:
+        /**
+         * Uses measured DAC transfer functions when converting DAC voltages.
+         * The compiled plan is then only valid for the fixture the calibration was made on.
+         * @param table a loaded calibration table, or nullptr for the ideal transfer function.
+         */
+        void setCalibration(const CalibrationTable* table);
+
+        /**
+         * Runs the step scheduler over the compiled recipe.
+         * @param enabled true to coalesce pin changes on the same port.
+         */
+        void setScheduling(bool enabled);
+
+        /** @returns the compiled instructions in the order they will run. */
+        const std::vector<PlanInstruction>& compiledInstructions() const;
+
+        /** @returns the compiled instructions in recipe order, before scheduling. */
+        const std::vector<PlanInstruction>& recipeInstructions() const;
+
+        /**
+         * Compiles a text recipe.
+         * @param recipePath the text recipe.
+         * @returns -1 if the recipe could not be read or has errors, errors are printed with their line.
+         */
+        int compile(const std::string& recipePath);
+
+        /**
+         * Writes the compiled plan to a file.
+         * @param planPath the output file.
+         * @returns -1 if the file could not be written.
+         */
+        int write(const std::string& planPath);
+};
+
+#endif
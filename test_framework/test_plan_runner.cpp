@@ -0,0 +1,194 @@
+/*
+ * test_plan_runner.cpp:
+ ***********************************************************************
+ * Executes compiled test plans on a fixture.
+ *      Walks the memory-mapped instruction stream and drives the boards,
+ *      nothing is parsed while the plan runs. Run through a bus worker,
+ *      each step is queued as one batch and the next step is queued
+ *      before the previous one is checked, so limit checks and logging
+ *      on the calling thread overlap the bus traffic.
+ ***********************************************************************
+ */
+
+
+#include <future>
+#include <utility>
+#include <vector>
+
+#include "test_plan_runner.hpp"
+
+
+TestPlanRunner::TestPlanRunner(FixtureBus& boards, LTC2380Controller& adc)
+    : boards(boards), LTC2380(adc) {
+};
+
+void TestPlanRunner::setLog(ResultLog* resultLog) {
+    log = resultLog;
+};
+
+int TestPlanRunner::run(const TestPlan& plan) {
+    failedMeasurements = 0;
+    firstFailedStep = -1;
+    loggedStep = -1;
+
+    const PlanInstruction* instructions = plan.instructions();
+    uint32_t count = plan.instructionCount();
+
+    for (uint32_t i = 0; i < count; i++) {
+        completeStep(instructions[i], boards.execute(operation(instructions[i])));
+    }
+
+    return failedMeasurements == 0 ? 0 : -1;
+};
+
+int TestPlanRunner::run(const TestPlan& plan, BusWorker& worker) {
+    failedMeasurements = 0;
+    firstFailedStep = -1;
+    loggedStep = -1;
+
+    const PlanInstruction* instructions = plan.instructions();
+    uint32_t count = plan.instructionCount();
+
+    /** A step queued to the bus worker. */
+    struct QueuedStep {
+        uint32_t first;
+        uint32_t count;
+        std::future<std::vector<BusResult>> results;
+    };
+    QueuedStep queue[PIPELINE_DEPTH];
+    int oldest = 0;
+    int queued = 0;
+    uint32_t next = 0;
+
+    while (next < count || queued > 0) {
+        // Keeps the bus fed, the next step is queued before the previous one is waited for.
+        while (next < count && queued < PIPELINE_DEPTH) {
+            QueuedStep& step = queue[(oldest + queued) % PIPELINE_DEPTH];
+            step.first = next;
+            std::vector<BusOperation> ops;
+            while (next < count && instructions[next].step == instructions[step.first].step) {
+                ops.push_back(operation(instructions[next]));
+                next++;
+            }
+            step.count = next - step.first;
+            step.results = worker.submitBatch(std::move(ops));
+            queued++;
+        }
+
+        // Checked and logged here while the bus runs the step queued after it.
+        QueuedStep& step = queue[oldest];
+        std::vector<BusResult> results = step.results.get();
+        for (uint32_t i = 0; i < step.count; i++) {
+            completeStep(instructions[step.first + i], results[i]);
+        }
+        oldest = (oldest + 1) % PIPELINE_DEPTH;
+        queued--;
+    }
+
+    return failedMeasurements == 0 ? 0 : -1;
+};
+
+bool TestPlanRunner::execute(const PlanInstruction& instruction, int32_t& value) {
+    return complete(instruction, boards.execute(operation(instruction)), value);
+};
+
+BusOperation TestPlanRunner::operation(const PlanInstruction& instruction) {
+    MCP23S17Controller::DIOPinInfo pin = {
+        instruction.device, instruction.channel, instruction.low, instruction.value
+    };
+    uint8_t pinMask = 0b00000001 << (instruction.value % 8);
+
+    switch (instruction.opcode) {
+        case PLAN_DIO_ON:
+            return BusWorker::dioPort(pin, pinMask, 0x00);
+        case PLAN_DIO_OFF:
+            return BusWorker::dioPort(pin, 0x00, pinMask);
+        case PLAN_DIO_PORT:
+            return BusWorker::dioPort(pin, instruction.high & 0xFF, (instruction.high >> 8) & 0xFF);
+        case PLAN_DAC:
+            return BusWorker::dacCode(instruction.device, instruction.channel, instruction.value);
+        case PLAN_ADC:
+            return BusWorker::adcRaw();
+        case PLAN_WAIT:
+        default:
+            return BusWorker::wait(instruction.low);
+    }
+};
+
+bool TestPlanRunner::complete(const PlanInstruction& instruction, const BusResult& result, int32_t& value) {
+    value = 0;
+    // A failed transfer never passes, the stimulus or measurement did not happen.
+    bool passed = !result.failed;
+    uint8_t status = result.failed ? LOG_STATUS_WRITE_FAILED : 0;
+
+    switch (instruction.opcode) {
+        case PLAN_DIO_ON:
+        case PLAN_DIO_OFF:
+            if (log != nullptr) {
+                log->recordAt(result.finished, instruction.step, LOG_DIO, instruction.low, instruction.value,
+                              instruction.opcode == PLAN_DIO_ON ? 1.0 : 0.0, passed, status);
+            }
+            break;
+        case PLAN_DIO_PORT: {
+            uint8_t setMask = instruction.high & 0xFF;
+            uint8_t clearMask = (instruction.high >> 8) & 0xFF;
+            if (log != nullptr) {
+                for (int bit = 0; bit < 8; bit++) {
+                    if ((setMask | clearMask) & (1 << bit)) {
+                        log->recordAt(result.finished, instruction.step, LOG_DIO, instruction.low, instruction.value + bit,
+                                      (setMask >> bit) & 1 ? 1.0 : 0.0, passed, status);
+                    }
+                }
+            }
+            break;
+        }
+        case PLAN_DAC:
+            if (log != nullptr) {
+                log->recordAt(result.finished, instruction.step, LOG_DAC, instruction.device*12 + instruction.channel,
+                              instruction.value, 0.0, passed, status);
+            }
+            break;
+        case PLAN_ADC: {
+            int raw = -1;
+            value = -1;
+            if (!result.failed) {
+                raw = result.value;
+                value = LTC2380.scale(raw, instruction.device == 1);
+            }
+            passed = passed && value >= instruction.low && value <= instruction.high;
+            if (log != nullptr) {
+                log->recordAt(result.finished, instruction.step, LOG_ADC, instruction.device, raw, value, passed,
+                              result.failed ? LOG_STATUS_READ_FAILED : 0);
+            }
+            break;
+        }
+        case PLAN_WAIT:
+            break;
+    }
+
+    return passed;
+};
+
+void TestPlanRunner::completeStep(const PlanInstruction& instruction, const BusResult& result) {
+    // Marks where each step starts so step timings can be recovered from the log.
+    if (log != nullptr && instruction.step != loggedStep) {
+        loggedStep = instruction.step;
+        log->recordAt(result.started, instruction.step, LOG_STEP, 0, 0, 0.0, true);
+    }
+
+    int32_t value;
+    if (!complete(instruction, result, value)) {
+        if (failedMeasurements == 0) {
+            firstFailedStep = instruction.step;
+        }
+        failedMeasurements++;
+    }
+};
+
+uint32_t TestPlanRunner::failures() {
+    return failedMeasurements;
+};
+
+int64_t TestPlanRunner::firstFailure() {
+    return firstFailedStep;
+};
@@ -0,0 +1,108 @@
+/*
+ * test_plan_runner.hpp:
+ ***********************************************************************
+ * Executes compiled test plans on a fixture.
+ *      Walks the memory-mapped instruction stream and drives the boards,
+ *      nothing is parsed while the plan runs. Run through a bus worker,
+ *      each step is queued as one batch and the next step is queued
+ *      before the previous one is checked, so limit checks and logging
+ *      on the calling thread overlap the bus traffic.
+ ***********************************************************************
+ */
+
+
+#include <cstdint>
+
+#include "test_plan.hpp"
+#include "result_log.hpp"
+#include "bus_worker.hpp"
+#include "../ic_controllers/fixture_bus.hpp"
+#include "../ic_controllers/LTC2380.hpp"
+
+#ifndef TESTPLANRUNNER
+#define TESTPLANRUNNER
+
+class TestPlanRunner {
+    private:
+        FixtureBus& boards;
+        LTC2380Controller& LTC2380;
+
+        /** Steps queued to the bus worker at once, one on the bus while the one before it is checked. */
+        static const int PIPELINE_DEPTH = 2;
+
+        /** Where every measurement and event is logged, nullptr to not log. */
+        ResultLog* log = nullptr;
+
+        /** Results of the last run. */
+        uint32_t failedMeasurements = 0;
+        int64_t firstFailedStep = -1;
+
+        /** Step of the last STEP record, so each step is marked once. */
+        int64_t loggedStep = -1;
+
+        /**
+         * @param instruction a plan instruction.
+         * @returns the bus operation carrying it out.
+         */
+        static BusOperation operation(const PlanInstruction& instruction);
+
+        /**
+         * Checks the result of an instruction against its limits and logs it, with the time it happened on the bus.
+         * @param instruction the instruction.
+         * @param result its bus result.
+         * @param value set to the scaled ADC value for ADC instructions, 0 for the others.
+         * @returns false if an ADC measurement was outside its limits or a transfer failed.
+         */
+        bool complete(const PlanInstruction& instruction, const BusResult& result, int32_t& value);
+
+        /** Completes an instruction of a run, marking where its step starts and counting failures. */
+        void completeStep(const PlanInstruction& instruction, const BusResult& result);
+
+    public:
+        /**
+         * Binds the runner to the fixture it drives.
+         * @param boards the fixture's bus.
+         * @param adc the LTC2380 controller, scales the ADC readings.
+         */
+        TestPlanRunner(FixtureBus& boards, LTC2380Controller& adc);
+
+        /**
+         * Logs every ADC measurement, DIO change and DAC change of following runs.
+         * @param resultLog an open result log, or nullptr to stop logging.
+         */
+        void setLog(ResultLog* resultLog);
+
+        /**
+         * Executes a single instruction on the calling thread, logging it if a log is set.
+         * @param instruction the instruction.
+         * @param value set to the scaled ADC value for ADC instructions, 0 for the others.
+         * @returns false if an ADC measurement was outside its limits or a transfer failed.
+         */
+        bool execute(const PlanInstruction& instruction, int32_t& value);
+
+        /**
+         * Executes every instruction of a plan in order on the calling thread.
+         * Nothing else may use the bus while a plan runs.
+         * @param plan a loaded test plan.
+         * @returns -1 if any ADC measurement was outside its limits or a transfer failed.
+         */
+        int run(const TestPlan& plan);
+
+        /**
+         * Executes every instruction of a plan in order on the bus worker's thread, one batch per step,
+         * with up to PIPELINE_DEPTH steps queued. Results are checked and logged on the calling thread.
+         * Each batch is one allocation, which real-time mode keeps in locked memory.
+         * @param plan a loaded test plan.
+         * @param worker a running bus worker owning the boards.
+         * @returns -1 if any ADC measurement was outside its limits or a transfer failed.
+         */
+        int run(const TestPlan& plan, BusWorker& worker);
+
+        /** @returns the number of ADC measurements outside their limits and failed transfers in the last run. */
+        uint32_t failures();
+
+        /** @returns the first step with a failure in the last run, -1 if none failed. */
+        int64_t firstFailure();
+};
+
+#endif
@@ -0,0 +1,485 @@
+/*
+ * test_server.cpp:
+ ***********************************************************************
+ * Test server, lets several tools share one fixture.
+ *      A single thread runs an epoll loop over the listening socket, the
+ *      clients, a timer for the ADC subscriptions and an eventfd used to
+ *      stop it. Every round each client runs batches while its bus time
+ *      credit covers them, due samples of every client are taken before
+ *      each batch, replies are sent straight from the batch without
+ *      copying unless the socket is full.
+ ***********************************************************************
+ */
+
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+
+#include "test_server.hpp"
+
+
+/** @returns CLOCK_MONOTONIC time in nanoseconds. */
+static uint64_t monotonicNs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+TestServer::TestServer(FixtureBus& boards, LTC2380Controller& adc)
+    : runner(boards, adc) {
+    batch.resize(SERVER_MAX_BATCH);
+    results.resize(SERVER_MAX_BATCH);
+};
+
+TestServer::~TestServer() {
+    close();
+};
+
+void TestServer::setLog(ResultLog* resultLog) {
+    runner.setLog(resultLog);
+};
+
+void TestServer::setCostModel(const BusCostModel& model) {
+    costModel = model;
+};
+
+int TestServer::open(const std::string& path) {
+    close();
+
+    struct sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        std::cout << "Socket path " << path << " is too long.\n";
+        return -1;
+    }
+    strcpy(address.sun_path, path.c_str());
+
+    listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (listenFd < 0 || epollFd < 0 || wakeFd < 0 || timerFd < 0) {
+        close();
+        return -1;
+    }
+
+    unlink(path.c_str());
+    // The umask keeps the socket from ever being reachable with wider permissions than SOCKET_MODE.
+    mode_t previousMask = umask(0777 & ~SOCKET_MODE);
+    int bound = bind(listenFd, (struct sockaddr*)&address, sizeof(address));
+    umask(previousMask);
+    if (bound < 0 || chmod(path.c_str(), SOCKET_MODE) < 0 || listen(listenFd, 16) < 0) {
+        std::cout << "Could not listen on " << path << ": " << strerror(errno) << "\n";
+        if (bound == 0) {
+            unlink(path.c_str());
+        }
+        close();
+        return -1;
+    }
+    socketPath = path;
+
+    // Clients are identified by their Client pointer, the other descriptors by a pointer to their member.
+    int* fds[3] = {&listenFd, &wakeFd, &timerFd};
+    for (int* fd : fds) {
+        struct epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.ptr = fd;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, *fd, &event);
+    }
+
+    return 0;
+};
+
+void TestServer::close() {
+    for (auto& client : clients) {
+        ::close(client->fd);
+    }
+    clients.clear();
+
+    int* fds[4] = {&listenFd, &epollFd, &wakeFd, &timerFd};
+    for (int* fd : fds) {
+        if (*fd >= 0) {
+            ::close(*fd);
+        }
+        *fd = -1;
+    }
+
+    if (!socketPath.empty()) {
+        unlink(socketPath.c_str());
+        socketPath.clear();
+    }
+};
+
+void TestServer::stop() {
+    running = false;
+    uint64_t one = 1;
+    if (write(wakeFd, &one, sizeof(one)) < 0) {
+        return;
+    }
+};
+
+int TestServer::serve() {
+    if (listenFd < 0) {
+        return -1;
+    }
+
+    running = true;
+    struct epoll_event events[64];
+    bool pending = false;
+
+    while (running) {
+        // Only blocks when no client has a complete message waiting.
+        int count = epoll_wait(epollFd, events, 64, pending ? 0 : -1);
+        if (count < 0 && errno != EINTR) {
+            return -1;
+        }
+
+        for (int i = 0; i < count; i++) {
+            void* source = events[i].data.ptr;
+            if (source == &listenFd) {
+                acceptClients();
+            } else if (source == &wakeFd || source == &timerFd) {
+                uint64_t expirations;
+                if (read(*(int*)source, &expirations, sizeof(expirations)) < 0) {
+                    continue;
+                }
+            } else {
+                Client* client = (Client*)source;
+                if (events[i].events & (EPOLLHUP | EPOLLERR)) {
+                    client->closing = true;
+                    client->output.clear();
+                    client->outputStart = 0;
+                }
+                if (events[i].events & EPOLLIN) {
+                    readClient(*client);
+                }
+                if (events[i].events & EPOLLOUT) {
+                    flushClient(*client);
+                }
+            }
+        }
+
+        // One round, due samples first, then every client gets its turn of bus time.
+        pending = false;
+        serviceAllSubscriptions();
+        for (auto& client : clients) {
+            if (client->closing || client->output.size() - client->outputStart > MAX_OUTPUT_BACKLOG) {
+                continue;
+            }
+
+            // Credit only builds up while a request waits, an idle client cannot save up bus time.
+            if (completeMessage(*client) == 0) {
+                client->creditUs = 0;
+                continue;
+            }
+            client->creditUs += TURN_QUANTUM_US;
+            while (!client->closing && client->output.size() - client->outputStart <= MAX_OUTPUT_BACKLOG
+                    && serviceMessage(*client)) {
+            }
+            pending |= !client->closing && completeMessage(*client) != 0;
+        }
+
+        for (size_t i = 0; i < clients.size();) {
+            Client& client = *clients[i];
+            updateEvents(client);
+            if (finished(client)) {
+                ::close(client.fd);
+                clients.erase(clients.begin() + i);
+            } else {
+                i++;
+            }
+        }
+        armTimer();
+    }
+
+    return 0;
+};
+
+void TestServer::acceptClients() {
+    while (true) {
+        int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            return;
+        }
+        clients.push_back(std::unique_ptr<Client>(new Client()));
+        Client& client = *clients.back();
+        client.fd = fd;
+
+        struct epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.ptr = &client;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+        client.events = EPOLLIN;
+    }
+};
+
+void TestServer::readClient(Client& client) {
+    // Moves the unhandled bytes to the front once the end of the buffer is reached.
+    if (client.inputEnd == INPUT_BUFFER_SIZE && client.inputStart > 0) {
+        memmove(client.input, client.input + client.inputStart, client.inputEnd - client.inputStart);
+        client.inputEnd -= client.inputStart;
+        client.inputStart = 0;
+    }
+
+    while (client.inputEnd < INPUT_BUFFER_SIZE) {
+        ssize_t received = recv(client.fd, client.input + client.inputEnd, INPUT_BUFFER_SIZE - client.inputEnd, 0);
+        if (received > 0) {
+            client.inputEnd += received;
+        } else if (received == 0) {
+            // Shut down or closed, either way the requests already received are answered first.
+            client.readClosed = true;
+            return;
+        } else if (errno != EAGAIN && errno != EINTR) {
+            client.closing = true;
+            return;
+        } else if (errno == EAGAIN) {
+            return;
+        }
+    }
+};
+
+void TestServer::flushClient(Client& client) {
+    while (client.outputStart < client.output.size()) {
+        ssize_t sent = ::send(client.fd, client.output.data() + client.outputStart,
+                              client.output.size() - client.outputStart, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno != EAGAIN && errno != EINTR) {
+                client.closing = true;
+                client.output.clear();
+                client.outputStart = 0;
+            }
+            return;
+        }
+        client.outputStart += sent;
+    }
+    client.output.clear();
+    client.outputStart = 0;
+};
+
+void TestServer::sendMessage(Client& client, const MessageHeader& header, const void* payload, size_t bytes) {
+    size_t total = sizeof(header) + bytes;
+    size_t sent = 0;
+
+    // Sends straight from the caller's buffers unless earlier replies are still queued.
+    if (client.output.size() == client.outputStart) {
+        struct iovec parts[2] = {{(void*)&header, sizeof(header)}, {(void*)payload, bytes}};
+        struct msghdr message = {};
+        message.msg_iov = parts;
+        message.msg_iovlen = bytes > 0 ? 2 : 1;
+        ssize_t result = sendmsg(client.fd, &message, MSG_NOSIGNAL);
+        if (result < 0 && errno != EAGAIN && errno != EINTR) {
+            client.closing = true;
+            client.output.clear();
+            client.outputStart = 0;
+            return;
+        }
+        sent = result < 0 ? 0 : result;
+    }
+
+    for (size_t i = sent; i < total; i++) {
+        client.output.push_back(i < sizeof(header) ? ((const uint8_t*)&header)[i]
+                                                   : ((const uint8_t*)payload)[i - sizeof(header)]);
+    }
+};
+
+void TestServer::reject(Client& client, uint32_t tag) {
+    MessageHeader header = {SERVER_ERROR, 0, tag};
+    sendMessage(client, header, nullptr, 0);
+    client.closing = true;
+};
+
+int TestServer::completeMessage(const Client& client) {
+    return messageSize(client.input + client.inputStart, client.inputEnd - client.inputStart);
+};
+
+bool TestServer::serviceMessage(Client& client) {
+    int size = completeMessage(client);
+    if (size == 0) {
+        return false;
+    }
+
+    // Copied out of the input buffer, which gives no alignment guarantee past its start.
+    MessageHeader header;
+    memcpy(&header, client.input + client.inputStart, sizeof(header));
+    if (size == -1) {
+        reject(client, header.tag);
+        return true;
+    }
+    const uint8_t* payload = client.input + client.inputStart + sizeof(header);
+    MessageHeader reply = {};
+
+    switch (header.type) {
+        case SERVER_BATCH: {
+            memcpy(batch.data(), payload, header.count * sizeof(PlanInstruction));
+
+            // The whole batch is checked first, a rejected batch touches nothing.
+            double costUs = 0;
+            for (int i = 0; i < header.count; i++) {
+                if (!TestPlan::validInstruction(batch[i])) {
+                    reject(client, header.tag);
+                    return true;
+                }
+                costUs += costModel.instructionUs(batch[i]);
+            }
+            if (costUs > SERVER_MAX_BATCH_US) {
+                reject(client, header.tag);
+                return true;
+            }
+            if (costUs > client.creditUs) {
+                return false;
+            }
+            client.creditUs -= costUs;
+
+            // Samples due by now are taken first, so no subscription waits longer than one batch.
+            serviceAllSubscriptions();
+            for (int i = 0; i < header.count; i++) {
+                int32_t value;
+                results[i].passed = runner.execute(batch[i], value) ? 1 : 0;
+                results[i].value = value;
+            }
+            reply = {SERVER_BATCH_RESULT, header.count, header.tag};
+            sendMessage(client, reply, results.data(), header.count * sizeof(BatchResult));
+            break;
+        }
+        case SERVER_SUBSCRIBE: {
+            PlanInstruction instruction;
+            memcpy(&instruction, payload, sizeof(instruction));
+            if (instruction.opcode != PLAN_ADC || !TestPlan::validInstruction(instruction)
+                    || header.tag < MIN_PERIOD_US || client.subscriptions.size() >= MAX_SUBSCRIPTIONS) {
+                reject(client, header.tag);
+                return true;
+            }
+            // Samples are not charged to the batch credit, so their load is bounded when subscribing instead.
+            double load = costModel.instructionUs(instruction) / header.tag;
+            if (client.sampleLoad + load > MAX_SAMPLE_LOAD) {
+                reject(client, header.tag);
+                return true;
+            }
+            Subscription subscription;
+            subscription.id = nextSubscriptionId++;
+            subscription.instruction = instruction;
+            subscription.periodNs = (uint64_t)header.tag * 1000;
+            subscription.nextDue = monotonicNs();
+            client.subscriptions.push_back(subscription);
+            client.sampleLoad += load;
+            reply = {SERVER_SUBSCRIBED, 0, subscription.id};
+            sendMessage(client, reply, nullptr, 0);
+            break;
+        }
+        case SERVER_UNSUBSCRIBE:
+            for (size_t i = 0; i < client.subscriptions.size(); i++) {
+                if (client.subscriptions[i].id == header.tag) {
+                    const Subscription& subscription = client.subscriptions[i];
+                    client.sampleLoad -= costModel.instructionUs(subscription.instruction) * 1000.0 / subscription.periodNs;
+                    client.subscriptions.erase(client.subscriptions.begin() + i);
+                    break;
+                }
+            }
+            // Rounding must not leave a client without subscriptions short of its budget.
+            if (client.subscriptions.empty()) {
+                client.sampleLoad = 0;
+            }
+            break;
+    }
+
+    client.inputStart += size;
+    if (client.inputStart == client.inputEnd) {
+        client.inputStart = 0;
+        client.inputEnd = 0;
+    }
+    return true;
+};
+
+void TestServer::serviceSubscriptions(Client& client, uint64_t now) {
+    for (Subscription& subscription : client.subscriptions) {
+        if (subscription.nextDue > now) {
+            continue;
+        }
+
+        Sample sample;
+        int32_t value;
+        sample.passed = runner.execute(subscription.instruction, value) ? 1 : 0;
+        sample.value = value;
+        sample.timestamp = monotonicNs();
+
+        MessageHeader header = {SERVER_SAMPLE, 1, subscription.id};
+        sendMessage(client, header, &sample, sizeof(sample));
+
+        // A subscription which fell behind skips the missed samples instead of bursting them.
+        subscription.nextDue += subscription.periodNs;
+        if (subscription.nextDue <= now) {
+            subscription.nextDue = now + subscription.periodNs;
+        }
+    }
+};
+
+void TestServer::serviceAllSubscriptions() {
+    uint64_t now = monotonicNs();
+    for (auto& client : clients) {
+        if (client->closing || client->output.size() - client->outputStart > MAX_OUTPUT_BACKLOG) {
+            continue;
+        }
+        serviceSubscriptions(*client, now);
+    }
+};
+
+bool TestServer::finished(const Client& client) {
+    if (client.output.size() != client.outputStart) {
+        return false;
+    }
+    // An invalid request left after a shutdown still gets its error reply, so only 0 means nothing is left.
+    return client.closing || (client.readClosed && completeMessage(client) == 0);
+};
+
+void TestServer::updateEvents(Client& client) {
+    size_t backlog = client.output.size() - client.outputStart;
+    uint32_t events = 0;
+    if (!client.closing && !client.readClosed && backlog <= MAX_OUTPUT_BACKLOG && client.inputEnd - client.inputStart < INPUT_BUFFER_SIZE) {
+        events |= EPOLLIN;
+    }
+    if (backlog > 0) {
+        events |= EPOLLOUT;
+    }
+
+    if (events != client.events) {
+        struct epoll_event event = {};
+        event.events = events;
+        event.data.ptr = &client;
+        epoll_ctl(epollFd, EPOLL_CTL_MOD, client.fd, &event);
+        client.events = events;
+    }
+};
+
+void TestServer::armTimer() {
+    uint64_t next = 0;
+    for (auto& client : clients) {
+        for (const Subscription& subscription : client->subscriptions) {
+            if (next == 0 || subscription.nextDue < next) {
+                next = subscription.nextDue;
+            }
+        }
+    }
+
+    // A zero it_value disarms the timer, so a due time of exactly 0 is moved to 1 ns.
+    struct itimerspec timer = {};
+    if (next != 0) {
+        timer.it_value.tv_sec = next / 1000000000ULL;
+        timer.it_value.tv_nsec = next % 1000000000ULL;
+        if (timer.it_value.tv_sec == 0 && timer.it_value.tv_nsec == 0) {
+            timer.it_value.tv_nsec = 1;
+        }
+    }
+    timerfd_settime(timerFd, TFD_TIMER_ABSTIME, &timer, nullptr);
+};
+
@@ -0,0 +1,226 @@
+/*
+ * test_server.hpp:
+ ***********************************************************************
+ * Test server, lets several tools share one fixture.
+ *      The serving thread owns the fixture's bus and is the only thread
+ *      touching it. Clients connect over a Unix domain
+ *      socket and send batches of plan instructions, or subscribe to
+ *      periodic ADC samples, see server_protocol.hpp. Clients share the
+ *      bus by predicted bus time (deficit round-robin over BusCostModel
+ *      estimates), every round each client is credited TURN_QUANTUM_US and
+ *      runs batches while its credit covers them, so a client sending long
+ *      characterization batches gets no more bus time than the production
+ *      runner sending short ones. A single batch is capped at
+ *      SERVER_MAX_BATCH_US, which bounds how long anyone waits. Samples
+ *      are not charged to the credit, every due sample of every client is
+ *      taken before each batch, so a sample is late by at most one batch,
+ *      and each client's subscriptions may only take MAX_SAMPLE_LOAD of
+ *      the bus.
+ ***********************************************************************
+ */
+
+
+#include <sys/types.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "server_protocol.hpp"
+#include "test_plan_runner.hpp"
+#include "bus_cost_model.hpp"
+#include "result_log.hpp"
+#include "../ic_controllers/fixture_bus.hpp"
+#include "../ic_controllers/LTC2380.hpp"
+
+#ifndef TESTSERVER
+#define TESTSERVER
+
+class TestServer {
+    private:
+        /** Executes the batched instructions, the same way compiled plans are run. */
+        TestPlanRunner runner;
+
+        /** Predicts the bus time of batches and samples, which is what clients are charged. */
+        BusCostModel costModel;
+
+        /** Bytes buffered per client, fits several of the largest batches. */
+        static const int INPUT_BUFFER_SIZE = 64 * 1024;
+
+        /** Replies queued for a slow client before it is no longer served. */
+        const size_t MAX_OUTPUT_BACKLOG = 1024 * 1024;
+
+        /** Subscription limits, per client. */
+        const size_t MAX_SUBSCRIPTIONS = 16;
+        const uint32_t MIN_PERIOD_US = 100;
+
+        /** Share of the bus time one client's subscriptions may take, the sum of their predicted read time over period. */
+        const double MAX_SAMPLE_LOAD = 0.1;
+
+        /** Bus time credited to each client with a batch waiting, every round. */
+        const double TURN_QUANTUM_US = 5000;
+
+        /** Permissions of the socket file, only the owner and its group may drive the fixture. */
+        const mode_t SOCKET_MODE = 0660;
+
+        /** A periodic ADC read streamed to a client. */
+        struct Subscription {
+            uint32_t id;
+            PlanInstruction instruction;
+            uint64_t periodNs;
+            uint64_t nextDue;
+        };
+
+        /** A connected client. */
+        struct Client {
+            int fd;
+            /** Received bytes, messages between inputStart and inputEnd are not handled yet. */
+            alignas(8) uint8_t input[INPUT_BUFFER_SIZE];
+            size_t inputStart = 0;
+            size_t inputEnd = 0;
+            /** Replies the socket did not take yet. */
+            std::vector<uint8_t> output;
+            size_t outputStart = 0;
+            std::vector<Subscription> subscriptions;
+            /** Share of the bus time the subscriptions take, at most MAX_SAMPLE_LOAD. */
+            double sampleLoad = 0;
+            /** Bus time the client's batches may still use, in microseconds. */
+            double creditUs = 0;
+            /** Events currently registered with epoll. */
+            uint32_t events = 0;
+            /** The client shut down its sending side, its queued requests are still served. */
+            bool readClosed = false;
+            bool closing = false;
+        };
+
+        int listenFd = -1;
+        int epollFd = -1;
+        int wakeFd = -1;
+        int timerFd = -1;
+        std::string socketPath;
+
+        std::vector<std::unique_ptr<Client>> clients;
+        uint32_t nextSubscriptionId = 1;
+        std::atomic<bool> running{false};
+
+        /** Reused for every batch and its reply, batches run whole so one buffer of each serves every client. */
+        std::vector<PlanInstruction> batch;
+        std::vector<BatchResult> results;
+
+        /** Accepts every pending connection. */
+        void acceptClients();
+
+        /**
+         * Reads everything the socket has, as long as it fits the input buffer.
+         * @param client the client.
+         */
+        void readClient(Client& client);
+
+        /**
+         * Sends queued replies until the socket would block.
+         * @param client the client.
+         */
+        void flushClient(Client& client);
+
+        /**
+         * Sends a message, queueing whatever the socket does not take right away.
+         * @param client the client.
+         * @param header the message header.
+         * @param payload the payload, nullptr if there is none.
+         * @param bytes size of the payload.
+         */
+        void sendMessage(Client& client, const MessageHeader& header, const void* payload, size_t bytes);
+
+        /**
+         * Rejects a message and closes the client once the error is sent.
+         * @param client the client.
+         * @param tag tag of the rejected message.
+         */
+        void reject(Client& client, uint32_t tag);
+
+        /**
+         * Handles the next complete message of a client, if there is one and the client's credit covers it.
+         * @param client the client.
+         * @returns true if a message was handled, false if there is none or it is a batch the credit does not cover yet.
+         */
+        bool serviceMessage(Client& client);
+
+        /**
+         * Reads and sends every subscription of a client which is due.
+         * @param client the client.
+         * @param now CLOCK_MONOTONIC time in nanoseconds.
+         */
+        void serviceSubscriptions(Client& client, uint64_t now);
+
+        /** Reads and sends every due subscription of every client that is still served, before each batch. */
+        void serviceAllSubscriptions();
+
+        /**
+         * @param client the client.
+         * @returns the size of the next message if it is complete, 0 if more bytes are needed, -1 if it is invalid,
+         *     see messageSize.
+         */
+        int completeMessage(const Client& client);
+
+        /**
+         * @param client the client.
+         * @returns true once the client can be closed, it is closing or has shut down with no complete request left,
+         *     and every reply has been sent.
+         */
+        bool finished(const Client& client);
+
+        /**
+         * Registers the events the client is ready for with epoll, reading stops while its replies back up.
+         * @param client the client.
+         */
+        void updateEvents(Client& client);
+
+        /** Arms the timer for the next due subscription. */
+        void armTimer();
+
+    public:
+        /**
+         * Binds the server to the fixture it shares.
+         * @param boards the fixture's bus.
+         * @param adc the LTC2380 controller, scales the ADC readings.
+         */
+        TestServer(FixtureBus& boards, LTC2380Controller& adc);
+        ~TestServer();
+
+        TestServer(const TestServer&) = delete;
+        TestServer& operator=(const TestServer&) = delete;
+
+        /**
+         * Logs every batched and streamed operation.
+         * @param resultLog an open result log, or nullptr to not log.
+         */
+        void setLog(ResultLog* resultLog);
+
+        /**
+         * Charges clients with a fitted or tuned bus timing instead of the default one.
+         * @param model the cost model, e.g. loaded from the timing file a dry run fitted.
+         */
+        void setCostModel(const BusCostModel& model);
+
+        /**
+         * Creates the socket with SOCKET_MODE permissions, replacing a stale socket file left at the path.
+         * @param path the socket path.
+         * @returns -1 if the socket could not be created.
+         */
+        int open(const std::string& path);
+
+        /**
+         * Serves clients on the calling thread until stop is called.
+         * @returns -1 if the server is not open.
+         */
+        int serve();
+
+        /** Makes serve return. Safe to call from a signal handler or another thread. */
+        void stop();
+
+        /** Disconnects every client and removes the socket. */
+        void close();
+};
+
+#endif
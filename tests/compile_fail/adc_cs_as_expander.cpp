@@ -0,0 +1,4 @@
+// expect: MCP23S17Handle needs primary expander chip selects
+#include "../../ic_controllers/device_handle.hpp"
+
+MCP23S17Handle<WiringPiBackend<0, 0>, AdcCs<25>, ExpanderCs<22>> expanders{WiringPiBackend<0, 0>()};
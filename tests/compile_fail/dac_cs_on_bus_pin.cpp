@@ -0,0 +1,5 @@
+// expect: The DAC chip select is a pin of the backend's SPI bus.
+#include "../../ic_controllers/device_handle.hpp"
+
+// 24 is SPI1 MISO.
+AD8802Handle<WiringPiBackend<1, 0>, DacCs<24>> dac{WiringPiBackend<1, 0>()};
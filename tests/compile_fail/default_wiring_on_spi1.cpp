@@ -0,0 +1,5 @@
+// expect: is a pin of the backend's SPI bus.
+#include "../../ic_controllers/fixture_bus.hpp"
+
+// DefaultWiring uses 24 and 29, SPI1 MISO and SCLK.
+HandleBus<WiringPiBackend<1, 0>> boards;
@@ -0,0 +1,4 @@
+// expect: There are 2 primary expanders, 0 and 1.
+#include "../../ic_controllers/device_handle.hpp"
+
+MCP23S17Controller::DIOPinInfo pin = DioPin<2, 0, 2, 0>::INFO;
@@ -0,0 +1,4 @@
+// expect: AD8802Handle needs a DAC chip select
+#include "../../ic_controllers/device_handle.hpp"
+
+AD8802Handle<WiringPiBackend<0, 0>, ExpanderCs<21>> dac{WiringPiBackend<0, 0>()};
@@ -0,0 +1,4 @@
+// expect: Every chip select and the CNV pin need their own pin.
+#include "../../ic_controllers/fixture_bus.hpp"
+
+HandleBus<WiringPiBackend<0, 0>, FixtureWiring<21, 22, 23, 23, 25, 29>> boards;
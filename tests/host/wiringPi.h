@@ -0,0 +1,27 @@
+/*
+ * wiringPi.h:
+ ***********************************************************************
+ * Host stand-in for the WiringPi header, declares only what the project
+ * uses so the tests build on machines without WiringPi. wiringpi_host.cpp
+ * defines them as no-ops for the unit tests that link hardware code.
+ ***********************************************************************
+ */
+
+
+#ifndef HOSTWIRINGPI
+#define HOSTWIRINGPI
+
+#define LOW 0
+#define HIGH 1
+#define INPUT 0
+#define OUTPUT 1
+
+extern "C" {
+int wiringPiSetup(void);
+void pinMode(int pin, int mode);
+void digitalWrite(int pin, int value);
+int digitalRead(int pin);
+void delayMicroseconds(unsigned int howLong);
+}
+
+#endif
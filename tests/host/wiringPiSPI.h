@@ -0,0 +1,17 @@
+/*
+ * wiringPiSPI.h:
+ ***********************************************************************
+ * Host stand-in for the WiringPi SPI header, see host/wiringPi.h.
+ ***********************************************************************
+ */
+
+
+#ifndef HOSTWIRINGPISPI
+#define HOSTWIRINGPISPI
+
+extern "C" {
+int wiringPiSPIxSetupMode(int number, int channel, int speed, int mode);
+int wiringPiSPIxDataRW(int number, int channel, unsigned char* data, int len);
+}
+
+#endif
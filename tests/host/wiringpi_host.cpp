@@ -0,0 +1,42 @@
+/*
+ * wiringpi_host.cpp:
+ ***********************************************************************
+ * Host stand-in for the WiringPi library, see host/wiringPi.h.
+ *      Every call does nothing and succeeds, so the unit tests link on
+ *      machines without WiringPi. SPI transfers leave the data as it is.
+ ***********************************************************************
+ */
+
+
+#include "wiringPi.h"
+#include "wiringPiSPI.h"
+
+
+extern "C" {
+
+int wiringPiSetup(void) {
+    return 0;
+};
+
+void pinMode(int pin, int mode) {
+};
+
+void digitalWrite(int pin, int value) {
+};
+
+int digitalRead(int pin) {
+    return LOW;
+};
+
+void delayMicroseconds(unsigned int howLong) {
+};
+
+int wiringPiSPIxSetupMode(int number, int channel, int speed, int mode) {
+    return 0;
+};
+
+int wiringPiSPIxDataRW(int number, int channel, unsigned char* data, int len) {
+    return len;
+};
+
+}
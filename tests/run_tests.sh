@@ -0,0 +1,49 @@
+#!/bin/bash
+# Host tests, run from the repository root: ./tests/run_tests.sh
+# Builds against the stand-in headers in tests/host, so WiringPi is not needed.
+
+CXX=${CXX:-g++}
+FLAGS="-std=c++17 -Itests/host"
+failed=0
+
+# Every compile_fail file must be rejected by the static_assert named on its first line.
+for file in tests/compile_fail/*.cpp; do
+    expected=$(head -1 "$file" | sed 's#^// expect: ##')
+    output=$($CXX $FLAGS -fsyntax-only "$file" 2>&1)
+    if [ $? -eq 0 ]; then
+        echo "FAIL $file compiled"
+        failed=1
+    elif ! grep -qF "$expected" <<< "$output"; then
+        echo "FAIL $file did not fail with: $expected"
+        echo "$output" | head -5
+        failed=1
+    else
+        echo "ok   $file"
+    fi
+done
+
+# Every unit test is built with the sources named on its first line and run with a scratch directory.
+scratch=$(mktemp -d)
+trap 'rm -rf "$scratch"' EXIT
+for file in tests/unit/*_test.cpp; do
+    sources=$(head -1 "$file" | sed 's#^// sources:##')
+    name=$(basename "$file" .cpp)
+    output=$($CXX $FLAGS -pthread "$file" $sources tests/host/wiringpi_host.cpp -o "$scratch/$name" 2>&1)
+    if [ $? -ne 0 ]; then
+        echo "FAIL $file did not build"
+        echo "$output" | head -20
+        failed=1
+        continue
+    fi
+    mkdir "$scratch/$name.d"
+    output=$("$scratch/$name" "$scratch/$name.d" 2>&1)
+    if [ $? -ne 0 ]; then
+        echo "FAIL $file"
+        echo "$output" | tail -20
+        failed=1
+    else
+        echo "ok   $file"
+    fi
+done
+
+exit $failed
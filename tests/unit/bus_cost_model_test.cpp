@@ -0,0 +1,126 @@
+// sources: test_framework/bus_cost_model.cpp test_framework/test_plan.cpp test_framework/step_scheduler.cpp ic_controllers/calibration_table.cpp
+/*
+ * bus_cost_model_test.cpp:
+ ***********************************************************************
+ * BusCostModel: fitting recovers the overheads a run was timed with,
+ * and timing files round-trip and are checked on load.
+ ***********************************************************************
+ */
+
+
+#include <cerrno>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "check.hpp"
+#include "../../test_framework/bus_cost_model.hpp"
+
+/** Steps that tell the three fitted overheads apart, DAC and ADC differ in GPIO writes per frame. */
+static const char* RECIPE =
+    "PIN a 0 3 5 1\n"
+    "STEP dio\n"
+    "DIO a ON\n"
+    "STEP dac\n"
+    "DAC 1 1 1.0\n"
+    "DAC 1 2 1.0\n"
+    "STEP adc\n"
+    "ADC VOLTAGE 0 10\n"
+    "STEP wait\n"
+    "WAIT 500\n"
+    "STEP mixed\n"
+    "DIO a OFF\n"
+    "ADC CURRENT 0 10\n"
+    "WAIT 20\n";
+
+static void writeFile(const std::string& path, const std::string& contents) {
+    std::ofstream file(path, std::ios::trunc);
+    file << contents;
+}
+
+static bool sameTiming(const BusTiming& a, const BusTiming& b, double tolerance) {
+    return std::fabs(a.spiClockHz - b.spiClockHz) <= tolerance
+        && std::fabs(a.frameOverheadUs - b.frameOverheadUs) <= tolerance
+        && std::fabs(a.gpioWriteUs - b.gpioWriteUs) <= tolerance
+        && std::fabs(a.csDelayUs - b.csDelayUs) <= tolerance
+        && std::fabs(a.sleepOverheadUs - b.sleepOverheadUs) <= tolerance
+        && std::fabs(a.cnvPulseUs - b.cnvPulseUs) <= tolerance;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cout << "Usage: " << argv[0] << " <scratch directory>\n";
+        return 1;
+    }
+    std::string directory = argv[1];
+    std::string recipePath = directory + "/timing_recipe.txt";
+    std::string planPath = directory + "/timing_plan.bin";
+    std::string timingPath = directory + "/bus.timing";
+    writeFile(recipePath, RECIPE);
+
+    TestPlanCompiler compiler;
+    CHECK(compiler.compile(recipePath) == 0);
+    CHECK(compiler.write(planPath) == 0);
+    TestPlan plan;
+    CHECK(plan.load(planPath) == 0);
+
+    // Step times predicted with other overheads stand in for a measured run, the fit must find those overheads.
+    BusTiming station;
+    station.frameOverheadUs = 25.0;
+    station.gpioWriteUs = 0.5;
+    station.sleepOverheadUs = 80.0;
+    std::vector<double> measured = BusCostModel(station).stepTimes(plan);
+    CHECK(measured.size() == 5);
+
+    BusCostModel model;
+    CHECK(model.fit(plan, measured) == 0);
+    CHECK(sameTiming(model.timing(), station, 1e-6));
+
+    // Unmeasured steps are skipped.
+    measured[3] = -1;
+    BusCostModel partial;
+    CHECK(partial.fit(plan, measured) == 0);
+    CHECK(sameTiming(partial.timing(), station, 1e-6));
+
+    // Nothing measured, nothing fitted.
+    BusCostModel unmeasured;
+    CHECK(unmeasured.fit(plan, std::vector<double>(5, -1)) == -1);
+    CHECK(sameTiming(unmeasured.timing(), BusTiming(), 0));
+
+    // A single step cannot separate the overheads, they are scaled together instead.
+    std::vector<double> only(5, -1);
+    only[0] = 2 * BusCostModel().stepTimes(plan)[0];
+    BusCostModel scaled;
+    CHECK(scaled.fit(plan, only) == 0);
+    CHECK_NEAR(scaled.stepTimes(plan)[0], only[0], 1e-6);
+    CHECK(scaled.timing().spiClockHz == BusTiming().spiClockHz && scaled.timing().csDelayUs == BusTiming().csDelayUs);
+
+    // Saved timing loads back exactly, an existing file is only replaced when asked to.
+    CHECK(model.save(timingPath) == 0);
+    BusCostModel loaded;
+    CHECK(loaded.load(timingPath) == 0);
+    CHECK(sameTiming(loaded.timing(), model.timing(), 0));
+    errno = 0;
+    CHECK(BusCostModel().save(timingPath) == -1 && errno == EEXIST);
+    CHECK(BusCostModel().save(timingPath, true) == 0);
+    CHECK(loaded.load(timingPath) == 0);
+    CHECK(sameTiming(loaded.timing(), BusTiming(), 0));
+
+    // Comments are skipped, names missing from the file keep their value.
+    writeFile(timingPath, "# tuned\n\ncsDelayUs 50\n");
+    CHECK(loaded.load(timingPath) == 0);
+    CHECK(loaded.timing().csDelayUs == 50 && loaded.timing().frameOverheadUs == BusTiming().frameOverheadUs);
+
+    // Bad files leave the timing as it was.
+    const char* invalid[] = {
+        "frameOverheadUs -1\n", "gpioWriteUs nan\n", "spiClockHz 0\n", "unknownUs 1\n", "csDelayUs 1 2\n", "csDelayUs\n"
+    };
+    for (const char* contents : invalid) {
+        writeFile(timingPath, contents);
+        CHECK(loaded.load(timingPath) == -1);
+        CHECK(loaded.timing().csDelayUs == 50);
+    }
+    CHECK(loaded.load(directory + "/missing.timing") == -1);
+
+    return checkResult();
+}
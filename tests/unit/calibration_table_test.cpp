@@ -0,0 +1,105 @@
+// sources: ic_controllers/calibration_table.cpp
+/*
+ * calibration_table_test.cpp:
+ ***********************************************************************
+ * CalibrationTable: the fit of a swept DAC output, and calibration
+ * files written and loaded back.
+ ***********************************************************************
+ */
+
+
+#include <cerrno>
+#include <string>
+#include <vector>
+
+#include "check.hpp"
+#include "../../ic_controllers/calibration_table.hpp"
+
+static const double MAX_VOLTAGE = 5.0;
+
+/** A sweep of a DAC output with the given transfer function and a bump of INL around mid scale. */
+static void sweep(ChannelCalibration& channel, double gain, double offset, double bump) {
+    for (int code = 0; code < CALIBRATION_CODES; code++) {
+        channel.measured[code] = gain*code + offset + (code == 128 ? bump : 0);
+    }
+}
+
+/** @returns the input value whose measured voltage is closest, the way the lookup must pick it. */
+static int closest(const ChannelCalibration& channel, double voltage) {
+    int best = 0;
+    for (int code = 1; code < CALIBRATION_CODES; code++) {
+        if (std::fabs(channel.measured[code] - voltage) < std::fabs(channel.measured[best] - voltage)) {
+            best = code;
+        }
+    }
+    return best;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cout << "Usage: " << argv[0] << " <scratch directory>\n";
+        return 1;
+    }
+    std::string path = std::string(argv[1]) + "/cal.bin";
+
+    // A linear sweep fits exactly.
+    ChannelCalibration linear = {};
+    sweep(linear, 0.0195, 0.01, 0);
+    double inl = CalibrationTable::fit(linear, MAX_VOLTAGE);
+    CHECK_NEAR(linear.gain, 0.0195, 1e-7);
+    CHECK_NEAR(linear.offset, 0.01, 1e-6);
+    CHECK(inl < 1e-6);
+
+    // Voltages below the first and above the last measured one clamp to the ends of the sweep.
+    CHECK(linear.codes[0] == 0);
+    CHECK(linear.codes[CALIBRATION_VOLTAGE_BINS - 1] == 255);
+    for (int bin = 0; bin < CALIBRATION_VOLTAGE_BINS; bin++) {
+        double voltage = bin * MAX_VOLTAGE / (CALIBRATION_VOLTAGE_BINS - 1);
+        CHECK(linear.codes[bin] == closest(linear, voltage));
+    }
+
+    // A single bent code shows up as the INL, and the lookup avoids it.
+    ChannelCalibration bent = {};
+    sweep(bent, 0.0195, 0.01, 0.05);
+    inl = CalibrationTable::fit(bent, MAX_VOLTAGE);
+    CHECK(inl > 0.045 && inl < 0.05);
+    int bin = (int)((0.0195*128 + 0.01) * (CALIBRATION_VOLTAGE_BINS - 1) / MAX_VOLTAGE + 0.5);
+    CHECK(bent.codes[bin] != 128);
+    CHECK(bent.codes[bin] == closest(bent, bin * MAX_VOLTAGE / (CALIBRATION_VOLTAGE_BINS - 1)));
+
+    // Every output gets its own gain, so the file can be checked channel by channel.
+    std::vector<ChannelCalibration> channels(CALIBRATION_DACS * CALIBRATION_OUTPUTS);
+    for (size_t i = 0; i < channels.size(); i++) {
+        sweep(channels[i], 0.019 + i * 0.00002, 0.005, 0);
+        CalibrationTable::fit(channels[i], MAX_VOLTAGE);
+    }
+    CHECK(CalibrationTable::write(path, 1.01, channels.data(), MAX_VOLTAGE) == 0);
+
+    CalibrationTable table;
+    CHECK(table.load(path) == 0);
+    CHECK(table.loaded());
+    CHECK(table.adcVoltageGain() == 1.01);
+    // The id is the nanosecond CLOCK_REALTIME time, well past 2001 in nanoseconds.
+    CHECK(table.created() > 1000000000ull * 1000000000ull);
+    uint64_t firstId = table.created();
+    for (int dac = 0; dac < CALIBRATION_DACS; dac++) {
+        for (int dacOutput = 0; dacOutput < CALIBRATION_OUTPUTS; dacOutput++) {
+            const ChannelCalibration& expected = channels[dac * CALIBRATION_OUTPUTS + dacOutput];
+            CHECK(table.channel(dac, dacOutput).gain == expected.gain);
+            CHECK(table.code(dac, dacOutput, 512 * MAX_VOLTAGE / (CALIBRATION_VOLTAGE_BINS - 1)) == expected.codes[512]);
+            CHECK(table.code(dac, dacOutput, -1.0) == expected.codes[0]);
+            CHECK(table.code(dac, dacOutput, 9.0) == expected.codes[CALIBRATION_VOLTAGE_BINS - 1]);
+        }
+    }
+    table.unload();
+
+    // An existing calibration is only replaced when asked to, and the new one gets a new id.
+    errno = 0;
+    CHECK(CalibrationTable::write(path, 1.0, channels.data(), MAX_VOLTAGE) == -1 && errno == EEXIST);
+    CHECK(CalibrationTable::write(path, 1.0, channels.data(), MAX_VOLTAGE, true) == 0);
+    CHECK(table.load(path) == 0);
+    CHECK(table.adcVoltageGain() == 1.0);
+    CHECK(table.created() != firstId);
+
+    return checkResult();
+}
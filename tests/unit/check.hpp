@@ -0,0 +1,35 @@
+/*
+ * check.hpp:
+ ***********************************************************************
+ * Checks for the host unit tests, see tests/run_tests.sh.
+ *      CHECK prints the failed expression with its line and keeps going,
+ *      so one run reports every failure. main returns checkResult().
+ ***********************************************************************
+ */
+
+
+#include <cmath>
+#include <iostream>
+
+#ifndef UNITCHECK
+#define UNITCHECK
+
+/** Number of failed checks so far. */
+inline int checkFailures = 0;
+
+#define CHECK(expression) \
+    do { \
+        if (!(expression)) { \
+            std::cout << __FILE__ << ":" << __LINE__ << ": CHECK(" #expression ") failed\n"; \
+            checkFailures++; \
+        } \
+    } while (0)
+
+#define CHECK_NEAR(actual, expected, tolerance) CHECK(std::fabs((actual) - (expected)) <= (tolerance))
+
+/** @returns the exit code of the test, 1 if any check failed. */
+inline int checkResult() {
+    return checkFailures == 0 ? 0 : 1;
+}
+
+#endif
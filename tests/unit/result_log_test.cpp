@@ -0,0 +1,74 @@
+// sources: test_framework/result_log.cpp
+/*
+ * result_log_test.cpp:
+ ***********************************************************************
+ * ResultLog: the ring keeps the newest records once it wraps, and the
+ * reader returns them oldest first.
+ ***********************************************************************
+ */
+
+
+#include <cerrno>
+#include <string>
+
+#include "check.hpp"
+#include "../../test_framework/result_log.hpp"
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cout << "Usage: " << argv[0] << " <scratch directory>\n";
+        return 1;
+    }
+    std::string path = std::string(argv[1]) + "/log.bin";
+
+    // The capacity is rounded up to a power of 2, 20 records wrap a ring of 8.
+    ResultLog log;
+    CHECK(log.open(path, 5) == 0);
+    CHECK(log.isOpen());
+    for (uint32_t i = 0; i < 20; i++) {
+        log.recordAt(1000 + i, i / 4, LOG_ADC, 1, i, i * 0.5, i % 2 == 0, i == 17 ? LOG_STATUS_READ_FAILED : 0);
+    }
+    log.close();
+    CHECK(!log.isOpen());
+
+    ResultLogReader reader;
+    CHECK(reader.load(path) == 0);
+    CHECK(reader.count() == 8);
+    for (uint64_t index = 0; index < reader.count() && index < 8; index++) {
+        const LogRecord& entry = reader.record(index);
+        uint32_t i = 12 + index;
+        CHECK(entry.sequence == i);
+        CHECK(entry.timestamp == 1000 + i);
+        CHECK(entry.step == i / 4);
+        CHECK(entry.event == LOG_ADC && entry.channel == 1);
+        CHECK(entry.raw == (int32_t)i);
+        CHECK(entry.value == i * 0.5);
+        CHECK(entry.passed == (i % 2 == 0));
+        CHECK(entry.status == (i == 17 ? LOG_STATUS_READ_FAILED : 0));
+    }
+    reader.unload();
+
+    // A log that has not wrapped yet holds every record.
+    CHECK(log.open(path, 8, true) == 0);
+    log.recordAt(1, 0, LOG_STEP, 0, 0, 0.0, true);
+    log.recordAt(2, 0, LOG_DIO, 5, 3, 1.0, true);
+    log.close();
+    CHECK(reader.load(path) == 0);
+    CHECK(reader.count() == 2);
+    if (reader.count() == 2) {
+        CHECK(reader.record(0).event == LOG_STEP && reader.record(1).event == LOG_DIO);
+    }
+    reader.unload();
+
+    // An existing log is only replaced when asked to, and the capacity must fit the header.
+    errno = 0;
+    CHECK(log.open(path, 8) == -1 && errno == EEXIST);
+    errno = 0;
+    CHECK(log.open(path, ResultLog::MAX_CAPACITY + 1, true) == -1 && errno == EINVAL);
+    CHECK(!log.isOpen());
+
+    // Anything that is not a result log does not load.
+    CHECK(reader.load(std::string(argv[1]) + "/missing.bin") == -1);
+
+    return checkResult();
+}
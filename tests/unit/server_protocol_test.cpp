@@ -0,0 +1,66 @@
+// sources:
+/*
+ * server_protocol_test.cpp:
+ ***********************************************************************
+ * messageSize: framing of the test server's client stream.
+ ***********************************************************************
+ */
+
+
+#include <cstring>
+
+#include "check.hpp"
+#include "../../test_framework/server_protocol.hpp"
+
+/** Room for the largest batch, one byte in so headers are misaligned like in a stream buffer. */
+static uint8_t buffer[1 + sizeof(MessageHeader) + (SERVER_MAX_BATCH + 1) * sizeof(PlanInstruction)];
+static uint8_t* const stream = buffer + 1;
+
+static void header(uint16_t type, uint16_t count) {
+    MessageHeader header = {type, count, 7};
+    memcpy(stream, &header, sizeof(header));
+}
+
+int main() {
+    const size_t instruction = sizeof(PlanInstruction);
+
+    // A partial header needs more bytes, whatever it starts with.
+    header(SERVER_BATCH, 1);
+    CHECK(messageSize(stream, 0) == 0);
+    CHECK(messageSize(stream, sizeof(MessageHeader) - 1) == 0);
+
+    // Batches are complete once every instruction arrived.
+    header(SERVER_BATCH, 3);
+    CHECK(messageSize(stream, sizeof(MessageHeader)) == 0);
+    CHECK(messageSize(stream, sizeof(MessageHeader) + 3*instruction - 1) == 0);
+    CHECK(messageSize(stream, sizeof(MessageHeader) + 3*instruction) == (int)(sizeof(MessageHeader) + 3*instruction));
+    CHECK(messageSize(stream, sizeof(MessageHeader) + 5*instruction) == (int)(sizeof(MessageHeader) + 3*instruction));
+
+    // The batch count must be 1 to SERVER_MAX_BATCH, checked before the payload arrives.
+    header(SERVER_BATCH, 0);
+    CHECK(messageSize(stream, sizeof(MessageHeader)) == -1);
+    header(SERVER_BATCH, SERVER_MAX_BATCH);
+    CHECK(messageSize(stream, sizeof(buffer) - 1) == (int)(sizeof(MessageHeader) + SERVER_MAX_BATCH*instruction));
+    header(SERVER_BATCH, SERVER_MAX_BATCH + 1);
+    CHECK(messageSize(stream, sizeof(MessageHeader)) == -1);
+
+    // A subscription is exactly one instruction.
+    header(SERVER_SUBSCRIBE, 1);
+    CHECK(messageSize(stream, sizeof(MessageHeader)) == 0);
+    CHECK(messageSize(stream, sizeof(MessageHeader) + instruction) == (int)(sizeof(MessageHeader) + instruction));
+    header(SERVER_SUBSCRIBE, 0);
+    CHECK(messageSize(stream, sizeof(MessageHeader) + instruction) == -1);
+    header(SERVER_SUBSCRIBE, 2);
+    CHECK(messageSize(stream, sizeof(MessageHeader) + 2*instruction) == -1);
+
+    header(SERVER_UNSUBSCRIBE, 0);
+    CHECK(messageSize(stream, sizeof(MessageHeader)) == (int)sizeof(MessageHeader));
+
+    // Replies and unknown types are never valid from a client.
+    header(SERVER_BATCH_RESULT, 1);
+    CHECK(messageSize(stream, sizeof(MessageHeader) + instruction) == -1);
+    header(SERVER_ERROR + 1, 0);
+    CHECK(messageSize(stream, sizeof(MessageHeader)) == -1);
+
+    return checkResult();
+}
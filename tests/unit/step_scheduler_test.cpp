@@ -0,0 +1,85 @@
+// sources: test_framework/step_scheduler.cpp
+/*
+ * step_scheduler_test.cpp:
+ ***********************************************************************
+ * StepScheduler: only consecutive changes on one port are merged and
+ * nothing is reordered.
+ ***********************************************************************
+ */
+
+
+#include <vector>
+
+#include "check.hpp"
+#include "../../test_framework/step_scheduler.hpp"
+
+/** A pin change on primary expander 0, fields as in PlanInstruction. */
+static PlanInstruction dio(bool on, int primaryPin, int secondaryPin, uint32_t step = 0) {
+    PlanInstruction instruction = {};
+    instruction.opcode = on ? PLAN_DIO_ON : PLAN_DIO_OFF;
+    instruction.channel = primaryPin;
+    instruction.value = secondaryPin;
+    instruction.step = step;
+    instruction.low = 2 + primaryPin;
+    return instruction;
+}
+
+static PlanInstruction wait(int microseconds) {
+    PlanInstruction instruction = {};
+    instruction.opcode = PLAN_WAIT;
+    instruction.low = microseconds;
+    return instruction;
+}
+
+static bool same(const PlanInstruction& a, const PlanInstruction& b) {
+    return a.opcode == b.opcode && a.device == b.device && a.channel == b.channel && a.value == b.value
+        && a.step == b.step && a.low == b.low && a.high == b.high;
+}
+
+int main() {
+    // a and b share port A of one secondary, c is another secondary, d is port B of a's secondary.
+    PlanInstruction aOn = dio(true, 3, 1), bOn = dio(true, 3, 2), cOn = dio(true, 4, 1);
+    PlanInstruction aOff = dio(false, 3, 1), dOn = dio(true, 3, 9), bOff = dio(false, 3, 2);
+
+    // Only a and b are adjacent on one port, merging a OFF or b OFF further back would reorder them.
+    std::vector<PlanInstruction> scheduled = StepScheduler::schedule({aOn, bOn, cOn, aOff, dOn, bOff}, {});
+    CHECK(scheduled.size() == 5);
+    if (scheduled.size() == 5) {
+        CHECK(scheduled[0].opcode == PLAN_DIO_PORT);
+        CHECK(scheduled[0].channel == 3 && scheduled[0].value == 0);
+        CHECK(scheduled[0].high == 0b110);
+        CHECK(same(scheduled[1], cOn));
+        CHECK(same(scheduled[2], aOff));
+        CHECK(same(scheduled[3], dOn));
+        CHECK(same(scheduled[4], bOff));
+    }
+
+    // Port B updates carry the port in value, pins to disable go to bits 8-15.
+    scheduled = StepScheduler::schedule({dio(true, 3, 9), dio(false, 3, 15)}, {});
+    CHECK(scheduled.size() == 1);
+    if (scheduled.size() == 1) {
+        CHECK(scheduled[0].opcode == PLAN_DIO_PORT && scheduled[0].value == 8);
+        CHECK(scheduled[0].high == (0b00000010 | 0b10000000 << 8));
+    }
+
+    // A second change to a pin already in the update keeps both changes.
+    scheduled = StepScheduler::schedule({aOn, aOff}, {});
+    CHECK(scheduled.size() == 2 && same(scheduled[0], aOn) && same(scheduled[1], aOff));
+
+    // WAITs, step boundaries and SYNC points end the update.
+    scheduled = StepScheduler::schedule({aOn, wait(10), bOn}, {});
+    CHECK(scheduled.size() == 3 && same(scheduled[0], aOn) && scheduled[1].opcode == PLAN_WAIT && same(scheduled[2], bOn));
+    scheduled = StepScheduler::schedule({aOn, dio(true, 3, 2, 1)}, {});
+    CHECK(scheduled.size() == 2);
+    scheduled = StepScheduler::schedule({aOn, bOn}, {1});
+    CHECK(scheduled.size() == 2 && same(scheduled[0], aOn) && same(scheduled[1], bOn));
+
+    // DAC writes are kept as they are.
+    PlanInstruction dac = {};
+    dac.opcode = PLAN_DAC;
+    dac.value = 100;
+    scheduled = StepScheduler::schedule({dac, dac}, {});
+    CHECK(scheduled.size() == 2 && same(scheduled[0], dac) && same(scheduled[1], dac));
+
+    return checkResult();
+}
@@ -0,0 +1,129 @@
+// sources: test_framework/test_plan.cpp test_framework/step_scheduler.cpp ic_controllers/calibration_table.cpp
+/*
+ * test_plan_test.cpp:
+ ***********************************************************************
+ * TestPlan: a compiled recipe loads back as compiled, and instructions
+ * out of range for the fixture are refused on load.
+ ***********************************************************************
+ */
+
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+#include "check.hpp"
+#include "../../test_framework/test_plan.hpp"
+#include "../../ic_controllers/dac_transfer.hpp"
+
+static const char* RECIPE =
+    "# Two steps, every statement once.\n"
+    "PIN a 0 3 5 1\n"
+    "PIN b 0 3 5 2\n"
+    "STEP first\n"
+    "DIO a ON\n"
+    "DIO b ON\n"
+    "DAC 1 2 2.5\n"
+    "WAIT 200\n"
+    "ADC VOLTAGE -10 10.5\n"
+    "STEP second\n"
+    "DIO a OFF\n"
+    "ADC CURRENT 0 100\n";
+
+static void writeFile(const std::string& path, const std::string& contents) {
+    std::ofstream file(path, std::ios::trunc);
+    file << contents;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cout << "Usage: " << argv[0] << " <scratch directory>\n";
+        return 1;
+    }
+    std::string directory = argv[1];
+    std::string recipePath = directory + "/recipe.txt";
+    std::string planPath = directory + "/plan.bin";
+    writeFile(recipePath, RECIPE);
+
+    // Round trip, the loaded plan is exactly what was compiled.
+    TestPlanCompiler compiler;
+    CHECK(compiler.compile(recipePath) == 0);
+    CHECK(compiler.write(planPath) == 0);
+    TestPlan plan;
+    CHECK(plan.load(planPath) == 0);
+    const std::vector<PlanInstruction>& compiled = compiler.compiledInstructions();
+    CHECK(plan.stepCount() == 2);
+    CHECK(plan.calibration() == 0);
+    CHECK(plan.instructionCount() == 7 && compiled.size() == 7);
+    if (plan.instructionCount() == 7 && compiled.size() == 7) {
+        CHECK(memcmp(plan.instructions(), compiled.data(), 7 * sizeof(PlanInstruction)) == 0);
+
+        const PlanInstruction* instructions = plan.instructions();
+        CHECK(instructions[0].opcode == PLAN_DIO_ON && instructions[0].channel == 3 && instructions[0].value == 1
+              && instructions[0].low == 5 && instructions[0].step == 0);
+        CHECK(instructions[2].opcode == PLAN_DAC && instructions[2].device == 0 && instructions[2].channel == 1
+              && instructions[2].value == idealDacCode(2.5));
+        CHECK(instructions[3].opcode == PLAN_WAIT && instructions[3].low == 200);
+        // ADC limits are widened to whole units.
+        CHECK(instructions[4].opcode == PLAN_ADC && instructions[4].device == 1
+              && instructions[4].low == -10 && instructions[4].high == 11);
+        CHECK(instructions[5].opcode == PLAN_DIO_OFF && instructions[5].step == 1);
+        CHECK(instructions[6].opcode == PLAN_ADC && instructions[6].device == 0);
+    }
+    plan.unload();
+
+    // Scheduling merges a and b, the recipe order is kept for comparison.
+    TestPlanCompiler scheduling;
+    scheduling.setScheduling(true);
+    CHECK(scheduling.compile(recipePath) == 0);
+    CHECK(scheduling.compiledInstructions().size() == 6);
+    CHECK(scheduling.recipeInstructions().size() == 7);
+    if (scheduling.compiledInstructions().size() == 6) {
+        CHECK(scheduling.compiledInstructions()[0].opcode == PLAN_DIO_PORT);
+        CHECK(scheduling.compiledInstructions()[0].high == 0b110);
+    }
+
+    // Recipe errors fail the compile.
+    TestPlanCompiler invalid;
+    writeFile(recipePath, "STEP\nDAC 3 1 1.0\n");
+    CHECK(invalid.compile(recipePath) == -1);
+    TestPlanCompiler beforeStep;
+    writeFile(recipePath, "WAIT 10\n");
+    CHECK(beforeStep.compile(recipePath) == -1);
+
+    // Out of range fields are refused, the runner indexes tables with them.
+    PlanInstruction dac = {};
+    dac.opcode = PLAN_DAC;
+    dac.channel = 11;
+    CHECK(TestPlan::validInstruction(dac));
+    dac.channel = 12;
+    CHECK(!TestPlan::validInstruction(dac));
+    PlanInstruction port = compiled[0];
+    port.opcode = PLAN_DIO_PORT;
+    port.value = 8;
+    CHECK(TestPlan::validInstruction(port));
+    port.value = 3;
+    CHECK(!TestPlan::validInstruction(port));
+    PlanInstruction unknown = {};
+    unknown.opcode = 99;
+    CHECK(!TestPlan::validInstruction(unknown));
+
+    // A plan file with an invalid instruction does not load.
+    FILE* file = fopen(planPath.c_str(), "r+b");
+    CHECK(file != nullptr);
+    if (file != nullptr) {
+        fseek(file, sizeof(PlanHeader) + 2 * sizeof(PlanInstruction) + offsetof(PlanInstruction, channel), SEEK_SET);
+        fputc(12, file);
+        fclose(file);
+    }
+    CHECK(plan.load(planPath) == -1);
+    CHECK(!plan.loaded());
+
+    // Nor does a truncated one.
+    writeFile(planPath, "ICTP");
+    CHECK(plan.load(planPath) == -1);
+
+    return checkResult();
+}
@@ -0,0 +1,155 @@
+/*
+ * log_exporter.cpp:
+ ***********************************************************************
+ * Converts a binary result log into files other tools can read.
+ *      Usage: ./log_exporter <log.bin> csv <out.csv>
+ *             ./log_exporter <log.bin> columns <out directory>
+ *      csv writes one row per record. columns writes one raw little-endian
+ *      file per field plus a schema.txt, which loads straight into numpy,
+ *      pandas or any columnar tool without parsing.
+ ***********************************************************************
+ */
+
+
+#include <sys/stat.h>
+#include <cerrno>
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+#include "../test_framework/result_log.hpp"
+
+
+/** Names of each LogEvent, used in the csv output. */
+const char* EVENT_NAMES[4] = {"ADC", "DIO", "DAC", "STEP"};
+
+/**
+ * Writes every record to a csv file, oldest first.
+ * @returns -1 if the file could not be written.
+ */
+int exportCsv(const ResultLogReader& log, const std::string& path) {
+    FILE* out = fopen(path.c_str(), "w");
+    if (out == nullptr) {
+        return -1;
+    }
+
+    fprintf(out, "timestamp_ns,sequence,step,event,channel,raw,value,passed,read_failed,write_failed\n");
+    for (uint64_t i = 0; i < log.count(); i++) {
+        const LogRecord& record = log.record(i);
+        const char* event = record.event < 4 ? EVENT_NAMES[record.event] : "UNKNOWN";
+        fprintf(out, "%llu,%u,%u,%s,%u,%d,%.9g,%u,%u,%u\n", (unsigned long long)record.timestamp, record.sequence,
+                record.step, event, record.channel, record.raw, record.value, record.passed,
+                record.status & LOG_STATUS_READ_FAILED ? 1 : 0, record.status & LOG_STATUS_WRITE_FAILED ? 1 : 0);
+    }
+
+    return fclose(out) == 0 ? 0 : -1;
+}
+
+/**
+ * Writes a single field of every record to its own file, oldest first.
+ * @returns -1 if the file could not be written.
+ */
+template <typename T>
+int exportColumn(const ResultLogReader& log, const std::string& path, T LogRecord::*field) {
+    FILE* out = fopen(path.c_str(), "wb");
+    if (out == nullptr) {
+        return -1;
+    }
+
+    // Buffered so each column is written in large blocks.
+    const int BLOCK = 4096;
+    T block[BLOCK];
+    size_t count = 0;
+    bool written = true;
+    for (uint64_t i = 0; i < log.count() && written; i++) {
+        block[count++] = log.record(i).*field;
+        if (count == BLOCK) {
+            written = fwrite(block, sizeof(T), count, out) == count;
+            count = 0;
+        }
+    }
+    if (written && count > 0) {
+        written = fwrite(block, sizeof(T), count, out) == count;
+    }
+
+    // fclose flushes the last buffered block, so it can fail too.
+    return fclose(out) == 0 && written ? 0 : -1;
+}
+
+/**
+ * Writes every field to its own file plus a schema describing them.
+ * @returns -1 if any file could not be written.
+ */
+int exportColumns(const ResultLogReader& log, const std::string& dir) {
+    // An existing directory is reused, anything else that stops it being created is an error.
+    struct stat info;
+    if (mkdir(dir.c_str(), 0755) != 0 && (errno != EEXIST || stat(dir.c_str(), &info) != 0 || !S_ISDIR(info.st_mode))) {
+        return -1;
+    }
+
+    FILE* schema = fopen((dir + "/schema.txt").c_str(), "w");
+    if (schema == nullptr) {
+        return -1;
+    }
+    fprintf(schema, "rows %llu\n", (unsigned long long)log.count());
+    fprintf(schema, "timestamp.bin uint64 CLOCK_MONOTONIC nanoseconds\n");
+    fprintf(schema, "sequence.bin uint32\n");
+    fprintf(schema, "step.bin uint32\n");
+    fprintf(schema, "event.bin uint8 0=ADC 1=DIO 2=DAC 3=STEP\n");
+    fprintf(schema, "channel.bin uint8\n");
+    fprintf(schema, "passed.bin uint8\n");
+    fprintf(schema, "status.bin uint8 bit0=ADC read failed bit1=DIO/DAC write failed\n");
+    fprintf(schema, "raw.bin int32\n");
+    fprintf(schema, "value.bin float64\n");
+    if (ferror(schema) != 0) {
+        fclose(schema);
+        return -1;
+    }
+    if (fclose(schema) != 0) {
+        return -1;
+    }
+
+    bool passed = true;
+    passed &= exportColumn(log, dir + "/timestamp.bin", &LogRecord::timestamp) == 0;
+    passed &= exportColumn(log, dir + "/sequence.bin", &LogRecord::sequence) == 0;
+    passed &= exportColumn(log, dir + "/step.bin", &LogRecord::step) == 0;
+    passed &= exportColumn(log, dir + "/event.bin", &LogRecord::event) == 0;
+    passed &= exportColumn(log, dir + "/channel.bin", &LogRecord::channel) == 0;
+    passed &= exportColumn(log, dir + "/passed.bin", &LogRecord::passed) == 0;
+    passed &= exportColumn(log, dir + "/status.bin", &LogRecord::status) == 0;
+    passed &= exportColumn(log, dir + "/raw.bin", &LogRecord::raw) == 0;
+    passed &= exportColumn(log, dir + "/value.bin", &LogRecord::value) == 0;
+    return passed ? 0 : -1;
+}
+
+int main(int argc, char** argv) {
+    if (argc != 4) {
+        std::cout << "Usage: " << argv[0] << " <log.bin> csv|columns <output>\n";
+        return 1;
+    }
+    std::string format = argv[2];
+
+    ResultLogReader log;
+    if (log.load(argv[1]) == -1) {
+        std::cout << "Not a valid result log: " << argv[1] << "\n";
+        return 1;
+    }
+
+    int result;
+    if (format == "csv") {
+        result = exportCsv(log, argv[3]);
+    } else if (format == "columns") {
+        result = exportColumns(log, argv[3]);
+    } else {
+        std::cout << "Unknown format: " << format << ", use csv or columns.\n";
+        return 1;
+    }
+
+    if (result == -1) {
+        std::cout << "Could not write: " << argv[3] << "\n";
+        return 1;
+    }
+
+    std::cout << "Exported " << log.count() << " records.\n";
+    return 0;
+}
@@ -0,0 +1,88 @@
+/*
+ * plan_compiler.cpp:
+ ***********************************************************************
+ * Compiles a text test recipe into a binary test plan.
+ *      Usage: ./plan_compiler <recipe.txt> <plan.bin> [calibration.bin] [--schedule] [--timing bus.timing]
+ *      With a calibration file DAC voltages use the measured transfer functions,
+ *      and the plan records which calibration it was compiled with.
+ *      With --schedule pin changes on the same port are coalesced, and the
+ *      bus time BusCostModel predicts before and after is printed, with the
+ *      timing a dry run fitted if --timing is given.
+ *      ADC limits are in scaled ADC units, raw x 20 x gain for voltage,
+ *      not volts. See test_framework/test_plan.hpp for the recipe format.
+ ***********************************************************************
+ */
+
+
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../test_framework/test_plan.hpp"
+#include "../test_framework/bus_cost_model.hpp"
+
+
+/**
+ * Prints one line of the bus time comparison.
+ * @param name what the time is of.
+ * @param microseconds the predicted bus time.
+ */
+static void printCost(const char* name, double microseconds) {
+    std::cout << name << std::fixed << std::setprecision(1) << microseconds / 1000.0 << " ms predicted bus time.\n";
+}
+
+int main(int argc, char** argv) {
+    std::vector<std::string> files;
+    bool schedule = false;
+    const char* timingPath = nullptr;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--schedule") {
+            schedule = true;
+        } else if (arg == "--timing" && i + 1 < argc) {
+            timingPath = argv[++i];
+        } else {
+            files.push_back(arg);
+        }
+    }
+
+    if (files.size() != 2 && files.size() != 3) {
+        std::cout << "Usage: " << argv[0] << " <recipe.txt> <plan.bin> [calibration.bin] [--schedule] [--timing bus.timing]\n";
+        return 1;
+    }
+
+    BusCostModel model;
+    if (timingPath != nullptr && model.load(timingPath) == -1) {
+        std::cout << "Could not load bus timing: " << timingPath << "\n";
+        return 1;
+    }
+
+    TestPlanCompiler compiler;
+    compiler.setScheduling(schedule);
+    CalibrationTable calibration;
+    if (files.size() == 3) {
+        if (calibration.load(files[2]) == -1) {
+            std::cout << "Could not load calibration: " << files[2] << "\n";
+            return 1;
+        }
+        compiler.setCalibration(&calibration);
+    }
+    if (compiler.compile(files[0]) == -1) {
+        std::cout << "Recipe failed to compile.\n";
+        return 1;
+    }
+
+    if (compiler.write(files[1]) == -1) {
+        std::cout << "Could not write test plan: " << files[1] << "\n";
+        return 1;
+    }
+
+    if (schedule) {
+        printCost("Recipe order:    ", model.totalUs(compiler.recipeInstructions()));
+        printCost("Scheduled order: ", model.totalUs(compiler.compiledInstructions()));
+    }
+
+    std::cout << "Test plan compiled!\n";
+    return 0;
+}